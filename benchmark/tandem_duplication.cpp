@@ -0,0 +1,109 @@
+// microbenchmark for the alignment of clipped reads as internal tandem duplications
+// usage: tandem_duplication [READS [MAX_ITD_LENGTH ...]]
+// half of the reads are tandem duplications, the other half are clipped at random,
+// such that the entire alignment window has to be searched without finding an alignment
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sam.h"
+#include "common.hpp"
+#include "read_chimeric_alignments.hpp"
+
+using namespace std;
+
+const unsigned int CONTIG_LENGTH = 1000000;
+const unsigned int READ_LENGTH = 100;
+
+char random_base() {
+	return "ACGT"[rand() % 4];
+}
+
+// make a BAM record of a read which is clipped at the end
+bam1_t* make_clipped_read(const string& contig_sequence, const unsigned int max_duplication_length, const bool is_tandem_duplication, const bool with_ambiguous_base) {
+
+	unsigned int clipped_length = 12 + rand() % 39;
+	unsigned int aligned_length = READ_LENGTH - clipped_length;
+	int position = 20000 + rand() % (CONTIG_LENGTH - 40000);
+	int end = position + aligned_length;
+
+	// the clipped sequence is a copy of the preceding sequence in case of a tandem duplication
+	string sequence = contig_sequence.substr(position, aligned_length);
+	unsigned int duplication_length = max(clipped_length, 9 + rand() % (max_duplication_length - 8));
+	for (unsigned int i = 0; i < clipped_length; ++i)
+		sequence += (is_tandem_duplication) ? contig_sequence[end - duplication_length + i] : random_base();
+	if (with_ambiguous_base)
+		sequence[aligned_length + clipped_length / 2] = 'N'; // prevents seeding
+
+	// fill the data section of the BAM record: name, CIGAR, sequence and qualities
+	const char name[8] = "read"; // padded with NULs like htslib does to align the CIGAR to 4 bytes
+	bam1_t* bam_record = bam_init1();
+	bam_record->core.tid = 0;
+	bam_record->core.pos = position;
+	bam_record->core.flag = BAM_FPAIRED | BAM_FPROPER_PAIR | BAM_FREAD1;
+	bam_record->core.l_qname = sizeof(name);
+	bam_record->core.l_extranul = sizeof(name) - strlen(name) - 1;
+	bam_record->core.n_cigar = 2;
+	bam_record->core.l_qseq = READ_LENGTH;
+	bam_record->l_data = sizeof(name) + 2 * sizeof(uint32_t) + (READ_LENGTH + 1) / 2 + READ_LENGTH;
+	bam_record->m_data = bam_record->l_data;
+	bam_record->data = (uint8_t*) calloc(bam_record->m_data, 1);
+	crash(bam_record->data == NULL, "failed to allocate memory");
+	memcpy(bam_record->data, name, sizeof(name));
+	uint32_t cigar[2] = { bam_cigar_gen(aligned_length, BAM_CMATCH), bam_cigar_gen(clipped_length, BAM_CSOFT_CLIP) };
+	memcpy(bam_get_cigar(bam_record), cigar, sizeof(cigar));
+	uint8_t* packed_sequence = bam_get_seq(bam_record);
+	for (unsigned int i = 0; i < READ_LENGTH; ++i)
+		packed_sequence[i / 2] |= seq_nt16_table[(unsigned char) sequence[i]] << ((i % 2) ? 0 : 4);
+	return bam_record;
+}
+
+int main(int argc, char** argv) {
+
+	int reads = 100000;
+	crash(argc > 1 && (!str_to_int(argv[1], reads) || reads <= 0), "invalid number of reads");
+	vector<int> max_itd_lengths;
+	for (int i = 2; i < argc; ++i) {
+		int max_itd_length;
+		crash(!str_to_int(argv[i], max_itd_length) || max_itd_length < 50, "maximum ITD length must be at least 50");
+		max_itd_lengths.push_back(max_itd_length);
+	}
+	if (max_itd_lengths.empty())
+		max_itd_lengths = { 100, 300, 1000, 3000 };
+
+	srand(1);
+	assembly_t assembly;
+	string& contig_sequence = assembly[0];
+	for (unsigned int i = 0; i < CONTIG_LENGTH; ++i)
+		contig_sequence += random_base();
+
+	cout << left << setw(16) << "max_itd_length" << setw(12) << "scan" << right << setw(14) << "reads/s" << setw(10) << "found" << endl;
+	for (auto max_itd_length = max_itd_lengths.begin(); max_itd_length != max_itd_lengths.end(); ++max_itd_length) {
+		// a clipped sequence with an N cannot be seeded, so the whole window is scanned like before seeding was introduced
+		for (unsigned int with_ambiguous_base = 0; with_ambiguous_base <= 1; ++with_ambiguous_base) {
+
+			vector<bam1_t*> bam_records;
+			for (int read = 0; read < reads; ++read)
+				bam_records.push_back(make_clipped_read(contig_sequence, min(*max_itd_length, 100), read % 2 == 0, with_ambiguous_base));
+
+			unsigned int found = 0;
+			auto start = chrono::steady_clock::now();
+			for (auto bam_record = bam_records.begin(); bam_record != bam_records.end(); ++bam_record) {
+				alignment_t tandem_alignment;
+				if (is_tandem_duplication(*bam_record, assembly, *max_itd_length, tandem_alignment))
+					found++;
+			}
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			cout << left << setw(16) << *max_itd_length << setw(12) << ((with_ambiguous_base) ? "exhaustive" : "seeded") << right << setw(14) << (unsigned long int) (reads / seconds) << setw(10) << found << endl;
+			for (auto bam_record = bam_records.begin(); bam_record != bam_records.end(); ++bam_record)
+				bam_destroy1(*bam_record);
+		}
+	}
+
+	return 0;
+}
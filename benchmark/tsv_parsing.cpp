@@ -0,0 +1,113 @@
+// microbenchmark for the parsing of tab-separated input files
+// usage: tsv_parsing [GTF_FILE [REPETITIONS]]
+// without a GTF file, a synthetic GTF file in the style of GENCODE is generated in $TMPDIR
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include "common.hpp"
+#include "annotation.hpp"
+#include "read_compressed_file.hpp"
+
+using namespace std;
+
+const char* ATTRIBUTE_SUFFIX = "; gene_type \"protein_coding\"; level 2; havana_gene \"OTTHUMG00000000001.1\";";
+
+string make_synthetic_gtf(const unsigned int genes) {
+	const char* tmpdir = getenv("TMPDIR");
+	string file_path = string((tmpdir != NULL) ? tmpdir : "/tmp") + "/arriba_benchmark_XXXXXX";
+	int file_descriptor = mkstemp(&file_path[0]);
+	crash(file_descriptor == -1, "failed to create temporary file");
+	FILE* file = fdopen(file_descriptor, "w");
+	crash(file == NULL, "failed to create temporary file");
+	for (unsigned int gene = 0; gene < genes; ++gene) {
+		int contig = gene % 22 + 1;
+		int gene_start = 10000 + (gene / 22) * 50000;
+		fprintf(file, "chr%d\tHAVANA\tgene\t%d\t%d\t.\t%c\t.\tgene_id \"ENSG%011u.1\"; gene_name \"GENE%u\"%s\n", contig, gene_start, gene_start + 40000, (gene % 2) ? '+' : '-', gene, gene, ATTRIBUTE_SUFFIX);
+		for (unsigned int transcript = 0; transcript < 3; ++transcript) {
+			unsigned int transcript_id = gene * 3 + transcript;
+			for (unsigned int exon = 0; exon < 8; ++exon) {
+				int exon_start = gene_start + exon * 5000 + transcript * 10;
+				for (unsigned int feature = 0; feature < 2; ++feature)
+					fprintf(file, "chr%d\tHAVANA\t%s\t%d\t%d\t.\t%c\t%s\tgene_id \"ENSG%011u.1\"; transcript_id \"ENST%011u.1\"; gene_name \"GENE%u\"; exon_number %u; exon_id \"ENSE%011u.1\"%s\n", contig, (feature == 0) ? "exon" : "CDS", exon_start, exon_start + 150, (gene % 2) ? '+' : '-', (feature == 0) ? "." : "0", gene, transcript_id, gene, exon + 1, transcript_id * 8 + exon, ATTRIBUTE_SUFFIX);
+			}
+		}
+	}
+	crash(fclose(file) != 0, "failed to write temporary file");
+	return file_path;
+}
+
+unsigned long int split_lines_into_strings(const vector<string>& lines) {
+	unsigned long int checksum = 0;
+	string field;
+	for (auto line = lines.begin(); line != lines.end(); ++line) {
+		tsv_stream_t tsv(*line);
+		while (!(tsv >> field).fail())
+			checksum += field.size();
+	}
+	return checksum;
+}
+
+unsigned long int split_lines_into_views(const vector<string>& lines) {
+	unsigned long int checksum = 0;
+	string_view_t field;
+	for (auto line = lines.begin(); line != lines.end(); ++line) {
+		tsv_stream_t tsv(*line);
+		while (!(tsv >> field).fail())
+			checksum += field.size;
+	}
+	return checksum;
+}
+
+unsigned long int parse_annotation(const string& gtf_file_path) {
+	contigs_t contigs;
+	vector<string> original_contig_names;
+	assembly_t assembly;
+	gene_annotation_t gene_annotation;
+	transcript_annotation_t transcript_annotation;
+	exon_annotation_t exon_annotation;
+	unordered_map<string,gene_t> gene_names;
+	read_annotation_gtf(gtf_file_path, DEFAULT_GTF_FEATURES, contigs, original_contig_names, assembly, gene_annotation, transcript_annotation, exon_annotation, gene_names, 1);
+	return exon_annotation.size();
+}
+
+template <class function_t> void measure(const string& name, const int repetitions, const unsigned long int bytes, function_t function) {
+	unsigned long int checksum = 0;
+	auto start = chrono::steady_clock::now();
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+		checksum += function();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
+	cout << left << setw(40) << name << right << fixed << setprecision(2) << setw(10) << seconds * 1000 << " ms" << setw(10) << bytes / seconds / 1024 / 1024 << " MB/s  (checksum " << checksum << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+
+	string gtf_file_path = (argc > 1) ? argv[1] : make_synthetic_gtf(5000);
+	int repetitions = 5;
+	crash(argc > 2 && !str_to_int(argv[2], repetitions) || repetitions <= 0, "invalid number of repetitions");
+
+	// load file into memory, so that only parsing is measured
+	vector<string> lines;
+	unsigned long int bytes = 0;
+	autodecompress_file_t gtf_file(gtf_file_path);
+	string line;
+	while (gtf_file.getline(line)) {
+		lines.push_back(line);
+		bytes += line.size() + 1;
+	}
+	cout << "lines: " << lines.size() << ", bytes: " << bytes << ", repetitions: " << repetitions << endl;
+
+	measure("split fields into strings", repetitions, bytes, [&]() { return split_lines_into_strings(lines); });
+	measure("split fields into views", repetitions, bytes, [&]() { return split_lines_into_views(lines); });
+	measure("read_annotation_gtf (incl. file I/O)", repetitions, bytes, [&]() { return parse_annotation(gtf_file_path); });
+
+	if (argc <= 1)
+		unlink(gtf_file_path.c_str());
+	return 0;
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <set>
 #include <string>
@@ -11,22 +13,27 @@
 
 using namespace std;
 
-bool get_gff3_attribute(const string& attributes, const string& attribute_name, string& attribute_value) {
-
-	// find start of attribute
-	size_t start = attributes.find(attribute_name + "=");
-	if (start >= attributes.size()) {
-		cerr << "WARNING: failed to extract " << attribute_name << " from line in GFF3 file: " << attributes << endl;
-		return false;
+bool get_gff3_attribute(const string_view_t& attributes, const char* attribute_name, string& attribute_value) {
+
+	// find start of attribute (searched in place to avoid allocating temporary strings)
+	const char* attributes_end = attributes.data + attributes.size;
+	const size_t attribute_name_length = strlen(attribute_name);
+	const char* start = attributes.data;
+	for (;; ++start) {
+		start = search(start, attributes_end, attribute_name, attribute_name + attribute_name_length);
+		if (start == attributes_end) {
+			cerr << "WARNING: failed to extract " << attribute_name << " from line in GFF3 file: " << attributes.str() << endl;
+			return false;
+		}
+		if (attributes_end - start > (ptrdiff_t) attribute_name_length && start[attribute_name_length] == '=')
+			break;
 	}
-	start += attribute_name.size() + 1; // move to position after "="
+	start += attribute_name_length + 1; // move to position after "="
 
 	// find end of attribute
-	size_t end = attributes.find(';', start);
-	if (end >= attributes.size())
-		end = attributes.size();
+	const char* end = find(start, attributes_end, ';');
 
-	attribute_value = attributes.substr(start, end - start);
+	attribute_value.assign(start, end - start);
 	return true;
 }
 
@@ -46,7 +53,8 @@ void load_protein_domains(const string& filename, const contigs_t& contigs, cons
 
 			tsv_stream_t tsv(line);
 			protein_domain_annotation_record_t protein_domain;
-			string contig, strand, attributes, gene_name, gene_id, trash;
+			string contig, gene_name, gene_id;
+			string_view_t strand, attributes, trash;
 
 			// parse line
 			tsv >> contig >> trash >> trash >> protein_domain.start >> protein_domain.end >> trash >> strand >> trash >> attributes;
@@ -247,7 +255,7 @@ string get_fusion_peptide_sequence(const string& transcript_sequence, const vect
 	    transcript_sequence.find("...|") < transcript_sequence.size() || transcript_sequence.find("|...") < transcript_sequence.size())
 		return ".";
 
-	if (assembly.find(gene_5->contig) == assembly.end() || assembly.find(gene_3->contig) == assembly.end())
+	if (!assembly.count(gene_5->contig) || !assembly.count(gene_3->contig))
 		return "."; // we need the assembly to search for the start codon
 
 	// split transcript into 5' and 3' parts and (possibly) non-template bases
@@ -1,15 +1,19 @@
 #include <algorithm>
 #include <cmath>
 #include <climits>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <string>
 #include <sstream>
 #include <set>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
+#include <unistd.h>
 #include "sam.h"
 #include "common.hpp"
 #include "annotation.hpp"
@@ -110,43 +114,108 @@ void remove_transcript(const transcript_t transcript_to_remove, gene_annotation_
 	}
 }
 
-bool get_gtf_attribute(const string& attributes, const vector<string>& attribute_names, string& attribute_value) {
-
-	// find start of attribute
-	size_t start = string::npos;
-	for (auto attribute_name = attribute_names.begin(); attribute_name != attribute_names.end() && start >= attributes.size(); ++attribute_name)
-		start = attributes.find(*attribute_name + " \"");
-	if (start < attributes.size())
-		start = attributes.find('"', start);
-	if (start >= attributes.size()) {
-		cerr << "WARNING: failed to extract ";
-		for (auto attribute_name = attribute_names.begin(); attribute_name != attribute_names.end(); ++attribute_name) {
-			if (attribute_name != attribute_names.begin())
-				cerr << "|";
-			cerr << *attribute_name;
+// warnings are collected rather than printed, since lines are parsed in parallel, but warnings should be reported in the order of the file
+// the attributes are searched in place, such that no temporary strings need to be allocated
+bool get_gtf_attribute(const string_view_t& attributes, const vector<string>& attribute_names, string& attribute_value, string& warnings) {
+
+	// find start of attribute (attribute name followed by space and quote)
+	const char* attributes_end = attributes.data + attributes.size;
+	const char* start = attributes_end;
+	for (auto attribute_name = attribute_names.begin(); attribute_name != attribute_names.end() && start == attributes_end; ++attribute_name) {
+		for (const char* match = attributes.data; match != attributes_end; ++match) {
+			match = search(match, attributes_end, attribute_name->begin(), attribute_name->end());
+			if (match == attributes_end)
+				break;
+			if (attributes_end - match >= (ptrdiff_t) attribute_name->size() + 2 && match[attribute_name->size()] == ' ' && match[attribute_name->size() + 1] == '"') {
+				start = match + attribute_name->size() + 1; // position of opening quote
+				break;
+			}
 		}
-		cerr << " from line in GTF file: " << attributes << endl;
-		return false;
 	}
-	start++;
-
-	// find end of attribute
-	size_t end = attributes.find('"', start);
-	if (end >= attributes.size()) {
-		cerr << "WARNING: failed to extract ";
+	const char* end = (start != attributes_end) ? find(start + 1, attributes_end, '"') : attributes_end;
+	if (end == attributes_end) {
+		warnings += "WARNING: failed to extract ";
 		for (auto attribute_name = attribute_names.begin(); attribute_name != attribute_names.end(); ++attribute_name) {
 			if (attribute_name != attribute_names.begin())
-				cerr << "|";
-			cerr << *attribute_name;
+				warnings += "|";
+			warnings += *attribute_name;
 		}
-		cerr << " from line in GTF file: " << attributes << endl;
+		warnings += " from line in GTF file: ";
+		warnings += attributes;
+		warnings += "\n";
 		return false;
 	}
-	attribute_value = attributes.substr(start, end - start);
+	start++;
+	attribute_value.assign(start, end - start); // reuses the capacity of attribute_value
 
 	return true;
 }
 
+// GTF lines are read in chunks of this many lines, which are parsed by multiple threads
+const unsigned int GTF_CHUNK_SIZE = 16384;
+
+enum gtf_feature_type_t { GTF_FEATURE_OTHER, GTF_FEATURE_EXON, GTF_FEATURE_CDS };
+
+// the fields of a GTF line, which can be extracted independently of all other lines
+struct parsed_gtf_line_t {
+	bool has_gene; // false, if the line is a comment or lacks a gene name/ID
+	bool has_transcript_id;
+	gtf_feature_type_t feature_type;
+	string contig, gene_name, gene_id, transcript_id;
+	position_t start, end;
+	strand_t strand;
+	string warnings;
+};
+
+void parse_gtf_line(const string& line, const gtf_features_t& gtf_features, parsed_gtf_line_t& parsed_line) {
+
+	parsed_line.has_gene = false;
+	parsed_line.warnings.clear();
+	if (line.empty() || line[0] == '#') // skip comment lines
+		return;
+
+	tsv_stream_t tsv(line);
+	string_view_t strand, feature, attributes, trash;
+
+	// parse line
+	tsv >> parsed_line.contig >> trash >> feature >> parsed_line.start >> parsed_line.end >> trash >> strand >> trash >> attributes;
+	if (tsv.fail() || parsed_line.contig.empty() || feature.empty() || strand.empty()) {
+		parsed_line.warnings = "WARNING: failed to parse line in GTF file: " + line + "\n";
+		return;
+	}
+	parsed_line.strand = (strand[0] == '+') ? FORWARD : REVERSE;
+
+	// extract gene name and ID from attributes
+	if (!get_gtf_attribute(attributes, gtf_features.gene_name, parsed_line.gene_name, parsed_line.warnings) ||
+	    !get_gtf_attribute(attributes, gtf_features.gene_id, parsed_line.gene_id, parsed_line.warnings))
+		return;
+	parsed_line.has_gene = true;
+
+	// extract transcript ID of exons and coding regions
+	if (find(gtf_features.feature_exon.begin(), gtf_features.feature_exon.end(), feature) != gtf_features.feature_exon.end())
+		parsed_line.feature_type = GTF_FEATURE_EXON;
+	else if (find(gtf_features.feature_cds.begin(), gtf_features.feature_cds.end(), feature) != gtf_features.feature_cds.end())
+		parsed_line.feature_type = GTF_FEATURE_CDS;
+	else
+		parsed_line.feature_type = GTF_FEATURE_OTHER;
+	if (parsed_line.feature_type != GTF_FEATURE_OTHER)
+		parsed_line.has_transcript_id = get_gtf_attribute(attributes, gtf_features.transcript_id, parsed_line.transcript_id, parsed_line.warnings);
+}
+
+// each thread parses a contiguous range of lines, such that the results can be processed in the order of the file
+void parse_gtf_lines(const vector<string>& lines, const size_t first_line, const size_t last_line, const gtf_features_t& gtf_features, vector<parsed_gtf_line_t>& parsed_lines) {
+	for (size_t line = first_line; line < last_line; ++line)
+		parse_gtf_line(lines[line], gtf_features, parsed_lines[line]);
+}
+
+size_t read_gtf_chunk(autodecompress_file_t& gtf_file, vector<string>& lines) {
+	lines.resize(GTF_CHUNK_SIZE); // the strings are reused between chunks to avoid reallocation
+	size_t line_count = 0;
+	while (line_count < lines.size() && gtf_file.getline(lines[line_count]))
+		line_count++;
+	return line_count;
+}
+
 bool sort_exons_by_coordinate(const exon_annotation_record_t* exon1, const exon_annotation_record_t* exon2) {
 	return *exon1 < *exon2;
 }
@@ -158,7 +227,7 @@ struct coding_region_t {
 	string transcript_id;
 };
 
-void read_annotation_gtf(const string& filename, const string& gtf_features_string, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names) {
+void read_annotation_gtf(const string& filename, const string& gtf_features_string, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names, const unsigned int threads) {
 
 	gtf_features_t gtf_features;
 	parse_gtf_features(gtf_features_string, gtf_features);
@@ -175,27 +244,37 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 	vector< tuple<string,contig_t,strand_t> > malformed_transcripts;
 
 	autodecompress_file_t gtf_file(filename);
-	string line;
 	set<string> non_unique_items;
 	unsigned int new_id = 0; // ID generator for genes and transcripts
-	while (gtf_file.getline(line)) {
-		if (!line.empty() && line[0] != '#') { // skip comment lines
 
-			tsv_stream_t tsv(line);
-			annotation_record_t annotation_record;
-			string contig, strand, feature, attributes, trash, gene_name, gene_id;
+	// the next chunk is read while the current one is parsed by worker threads,
+	// but the parsed lines are processed sequentially to assign IDs in the order of the file
+	vector<string> chunks[2];
+	size_t line_counts[2] = { read_gtf_chunk(gtf_file, chunks[0]), 0 };
+	vector<parsed_gtf_line_t> parsed_lines(GTF_CHUNK_SIZE);
+	for (unsigned int chunk = 0; line_counts[chunk % 2] > 0; ++chunk) {
+		const vector<string>& lines = chunks[chunk % 2];
+		const size_t line_count = line_counts[chunk % 2];
+		if (threads > 1) {
+			vector<thread> workers;
+			for (unsigned int worker = 0; worker < threads; ++worker)
+				workers.push_back(thread(parse_gtf_lines, cref(lines), line_count * worker / threads, line_count * (worker + 1) / threads, cref(gtf_features), ref(parsed_lines)));
+			line_counts[(chunk + 1) % 2] = read_gtf_chunk(gtf_file, chunks[(chunk + 1) % 2]);
+			for (auto worker = workers.begin(); worker != workers.end(); ++worker)
+				worker->join();
+		} else {
+			parse_gtf_lines(lines, 0, line_count, gtf_features, parsed_lines);
+			line_counts[(chunk + 1) % 2] = read_gtf_chunk(gtf_file, chunks[(chunk + 1) % 2]);
+		}
 
-			// parse line
-			tsv >> contig >> trash >> feature >> annotation_record.start >> annotation_record.end >> trash >> strand >> trash >> attributes;
-			if (tsv.fail() || contig.empty() || feature.empty() || strand.empty()) {
-				cerr << "WARNING: failed to parse line in GTF file: " << line << endl;
-				continue;
-			}
+		for (auto parsed_line = parsed_lines.begin(); parsed_line != parsed_lines.begin() + line_count; ++parsed_line) {
 
-			// extract gene name and ID from attributes
-			if (!get_gtf_attribute(attributes, gtf_features.gene_name, gene_name) ||
-			    !get_gtf_attribute(attributes, gtf_features.gene_id, gene_id))
+			cerr << parsed_line->warnings;
+			if (!parsed_line->has_gene)
 				continue;
+			const string& contig = parsed_line->contig;
+			const string& gene_name = parsed_line->gene_name;
+			const string& gene_id = parsed_line->gene_id;
 			string short_gene_id = strip_ensembl_version_number(gene_id);
 
 			// convert string representation of contig to numeric ID
@@ -206,12 +285,13 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 			original_contig_names[find_contig_by_name.first->second] = contig;
 
 			// make annotation record
+			annotation_record_t annotation_record;
 			annotation_record.contig = find_contig_by_name.first->second;
-			annotation_record.start--; // GTF files are one-based
-			annotation_record.end--; // GTF files are one-based
-			annotation_record.strand = (strand[0] == '+') ? FORWARD : REVERSE;
+			annotation_record.start = parsed_line->start - 1; // GTF files are one-based
+			annotation_record.end = parsed_line->end - 1; // GTF files are one-based
+			annotation_record.strand = parsed_line->strand;
 
-			if (find(gtf_features.feature_exon.begin(), gtf_features.feature_exon.end(), feature) != gtf_features.feature_exon.end()) {
+			if (parsed_line->feature_type == GTF_FEATURE_EXON) {
 
 				// make exon annotation record
 				exon_annotation_record_t exon_annotation_record;
@@ -220,11 +300,10 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 				exon_annotation_record.coding_region_end = -1;
 
 				// extract transcript ID from attributes
-				string transcript_id;
-				if (!get_gtf_attribute(attributes, gtf_features.transcript_id, transcript_id))
+				if (!parsed_line->has_transcript_id)
 					continue;
+				const string& transcript_id = parsed_line->transcript_id;
 				string short_transcript_id = strip_ensembl_version_number(transcript_id);
-
 				// make transcript annotation record
 				transcript_t& transcript = transcripts[make_tuple(short_transcript_id, annotation_record.contig, annotation_record.strand)];
 				if (transcript == NULL) { // this is the first time we encounter this transcript ID => make a new transcript_annotation_record_t
@@ -234,7 +313,7 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 					transcript_annotation_record.first_exon = NULL; // is set once we have loaded all exons
 					transcript_annotation_record.last_exon = NULL; // is set once we have loaded all exons
 					transcript_annotation.push_back(transcript_annotation_record);
-					transcript = &(*transcript_annotation.rbegin());
+					transcript = &transcript_annotation.back();
 				}
 				exon_annotation_record.transcript = transcript;
 
@@ -250,7 +329,7 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 					gene_annotation_record.is_dummy = false;
 					gene_annotation_record.is_protein_coding = false;
 					gene_annotation.push_back(gene_annotation_record);
-					gene = &(*gene_annotation.rbegin());
+					gene = &gene_annotation.back();
 				} else { // gene has already been seen previously
 					// expand the boundaries of the gene, so that all exons fit inside
 					if (gene->start > exon_annotation_record.start)
@@ -266,7 +345,7 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 						malformed_genes.insert(gene);
 					}
 				}
-				if (assembly.find(gene->contig) != assembly.end() && (unsigned int) gene->end >= assembly.at(gene->contig).size()) {
+				if (assembly.count(gene->contig) && (unsigned int) gene->end >= assembly.length(gene->contig)) {
 					if (non_unique_items.find(gene_id) == non_unique_items.end()) {
 						cerr << "WARNING: gene with ID '" << gene_id << "' extends beyond end of contig and will be ignored" << endl;
 						non_unique_items.insert(gene_id); // report gene only once
@@ -278,9 +357,9 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 				exon_annotation.push_back(exon_annotation_record);
 
 				// keep track of all exons of a transcript, so we can map coding regions to exons later
-				exons_by_transcript_id[make_tuple(transcript_id, annotation_record.contig, annotation_record.strand)].push_back(&(*exon_annotation.rbegin()));
+				exons_by_transcript_id[make_tuple(transcript_id, annotation_record.contig, annotation_record.strand)].push_back(&exon_annotation.back());
 
-			} else if (find(gtf_features.feature_cds.begin(), gtf_features.feature_cds.end(), feature) != gtf_features.feature_cds.end()) {
+			} else if (parsed_line->feature_type == GTF_FEATURE_CDS) {
 
 				// remember which regions of an exon are coding
 				coding_region_t coding_region;
@@ -288,8 +367,9 @@ void read_annotation_gtf(const string& filename, const string& gtf_features_stri
 				coding_region.contig = annotation_record.contig;
 				coding_region.start = annotation_record.start;
 				coding_region.end = annotation_record.end;
-				if (!get_gtf_attribute(attributes, gtf_features.transcript_id, coding_region.transcript_id))
+				if (!parsed_line->has_transcript_id)
 					continue;
+				coding_region.transcript_id = parsed_line->transcript_id;
 				coding_regions.push_back(coding_region);
 			}
 		}
@@ -422,6 +502,19 @@ bool is_breakpoint_spliced(const gene_t gene, const direction_t direction, const
 	return false;
 }
 
+// same as above, but the results are memoized, since the same pairs of gene sets are combined over and over again
+void combine_annotations(const interned_gene_set_t& genes1, const interned_gene_set_t& genes2, interned_gene_set_t& combined, bool make_union) {
+	gene_set_table_t& gene_set_table = get_gene_set_table();
+	unsigned int combined_id;
+	if (!gene_set_table.find_combination(genes1.get_id(), genes2.get_id(), make_union, combined_id)) {
+		gene_set_t combined_genes;
+		combine_annotations((const gene_set_t&) genes1, (const gene_set_t&) genes2, combined_genes, make_union);
+		combined_id = gene_set_table.intern(combined_genes);
+		gene_set_table.add_combination(genes1.get_id(), genes2.get_id(), make_union, combined_id);
+	}
+	combined = interned_gene_set_t(combined_id);
+}
+
 void annotate_alignment(alignment_t& alignment, gene_set_t& gene_set, const exon_annotation_index_t& exon_annotation_index) {
 
 	// first, try to annotate based on the boundaries (start+end) of the alignment
@@ -500,7 +593,9 @@ void annotate_alignments(mates_t& mates, const exon_annotation_index_t& exon_ann
 
 	// annotate each mate individually
 	for (mates_t::iterator mate = mates.begin(); mate != mates.end(); ++mate) {
-		annotate_alignment(*mate, mate->genes, exon_annotation_index);
+		gene_set_t genes;
+		annotate_alignment(*mate, genes, exon_annotation_index);
+		mate->genes = genes;
 		mate->exonic = !mate->genes.empty();
 	}
 
@@ -521,7 +616,7 @@ void annotate_alignments(mates_t& mates, const exon_annotation_index_t& exon_ann
 	if (mates.size() == 3) { // split read
 
 		// try to resolve ambiguous mappings using mapping information from mate
-		gene_set_t combined;
+		interned_gene_set_t combined;
 		combine_annotations(mates[SPLIT_READ].genes, mates[MATE1].genes, combined);
 		if (mates[MATE1].genes.empty() || combined.size() < mates[MATE1].genes.size())
 			mates[MATE1].genes = combined;
@@ -549,10 +644,10 @@ void annotate_alignments(mates_t& mates, const exon_annotation_index_t& exon_ann
 }
 
 // when a read overlaps with multiple genes, this function returns the boundaries of the biggest one
-void get_boundaries_of_biggest_gene(gene_set_t& genes, position_t& start, position_t& end) {
+void get_boundaries_of_biggest_gene(const gene_set_t& genes, position_t& start, position_t& end) {
 	start = -1;
 	end = -1;
-	for (gene_set_t::iterator gene = genes.begin(); gene != genes.end(); ++gene) {
+	for (gene_set_t::const_iterator gene = genes.begin(); gene != genes.end(); ++gene) {
 		if (start == -1 || start > (**gene).start)
 			start = (**gene).start;
 		if (end == -1 || end < (**gene).end)
@@ -611,3 +706,289 @@ int get_spliced_distance(const contig_t contig, position_t position1, position_t
 	return distance;
 }
 
+
+// the annotation cache is a snapshot of the records and indices produced by read_annotation_gtf() and make_annotation_index()
+// records reference each other by their index in the annotation_t, since pointers are not stable between runs
+const char ANNOTATION_CACHE_SIGNATURE[] = "ARRIBA_ANNOTATION_1";
+const uint32_t NO_RECORD = UINT32_MAX;
+
+template <class T> void write_annotation_cache_value(FILE* file, const T& value) {
+	crash(fwrite(&value, sizeof(T), 1, file) != 1, "failed to write annotation cache");
+}
+
+void write_annotation_cache_value(FILE* file, const string& value) {
+	write_annotation_cache_value(file, (uint32_t) value.size());
+	crash(!value.empty() && fwrite(value.data(), 1, value.size(), file) != value.size(), "failed to write annotation cache");
+}
+
+template <class T> void read_annotation_cache_value(FILE* file, T& value) {
+	crash(fread(&value, sizeof(T), 1, file) != 1, "failed to read annotation cache: file is truncated");
+}
+
+void read_annotation_cache_value(FILE* file, string& value) {
+	uint32_t length;
+	read_annotation_cache_value(file, length);
+	value.resize(length);
+	crash(length > 0 && fread(&value[0], 1, length, file) != length, "failed to read annotation cache: file is truncated");
+}
+
+template <class T> unordered_map<const T*,uint32_t> get_record_indices(const annotation_t<T>& annotation) {
+	unordered_map<const T*,uint32_t> record_indices;
+	record_indices.reserve(annotation.slots());
+	for (uint32_t record = 0; record < annotation.slots(); ++record)
+		record_indices[&annotation[record]] = record;
+	return record_indices;
+}
+
+template <class T> uint32_t get_record_index(const unordered_map<const T*,uint32_t>& record_indices, const T* record) {
+	return (record == NULL) ? NO_RECORD : record_indices.at(record);
+}
+
+template <class T> T* get_record(annotation_t<T>& annotation, const uint32_t record) {
+	crash(record != NO_RECORD && record >= annotation.slots(), "malformed annotation cache");
+	return (record == NO_RECORD) ? NULL : &annotation[record];
+}
+
+template <class T> void write_annotation_index_to_cache(FILE* file, const annotation_index_t<T*>& annotation_index, const unordered_map<const T*,uint32_t>& record_indices) {
+	write_annotation_cache_value(file, (uint32_t) annotation_index.size());
+	for (auto contig = annotation_index.begin(); contig != annotation_index.end(); ++contig) {
+		write_annotation_cache_value(file, (uint32_t) contig->size());
+		for (auto position = contig->begin(); position != contig->end(); ++position) {
+			write_annotation_cache_value(file, position->first);
+			write_annotation_cache_value(file, (uint32_t) position->second.size());
+			for (auto record = position->second.begin(); record != position->second.end(); ++record)
+				write_annotation_cache_value(file, get_record_index(record_indices, (const T*) *record));
+		}
+	}
+}
+
+template <class T> void read_annotation_index_from_cache(FILE* file, annotation_index_t<T*>& annotation_index, annotation_t<T>& annotation) {
+	uint32_t contig_count;
+	read_annotation_cache_value(file, contig_count);
+	annotation_index.clear();
+	annotation_index.resize(contig_count);
+	for (auto contig = annotation_index.begin(); contig != annotation_index.end(); ++contig) {
+		uint32_t position_count;
+		read_annotation_cache_value(file, position_count);
+		for (uint32_t i = 0; i < position_count; ++i) {
+			position_t position;
+			read_annotation_cache_value(file, position);
+			uint32_t record_count;
+			read_annotation_cache_value(file, record_count);
+			annotation_set_t<T*>& annotation_set = contig->emplace_hint(contig->end(), position, annotation_set_t<T*>())->second;
+			annotation_set.resize(record_count);
+			for (uint32_t record = 0; record < record_count; ++record) {
+				uint32_t record_index;
+				read_annotation_cache_value(file, record_index);
+				annotation_set[record] = get_record(annotation, record_index);
+			}
+			sort(annotation_set.begin(), annotation_set.end()); // annotation sets are ordered by address, which differs from the previous run
+		}
+	}
+}
+
+// the cache is only valid for the same GTF file, GTF features, and assembly
+string get_annotation_cache_key(const string& gtf_file_path, const string& gtf_features, const contigs_t& contigs, const vector<string>& original_contig_names, const assembly_t& assembly) {
+
+	// compute FNV-1a checksum of the (possibly compressed) GTF file
+	FILE* gtf_file = fopen(gtf_file_path.c_str(), "rb");
+	crash(gtf_file == NULL, "failed to open GTF file: " + gtf_file_path);
+	uint64_t checksum = 14695981039346656037ULL;
+	vector<unsigned char> buffer(1024 * 1024);
+	size_t bytes_read;
+	while ((bytes_read = fread(buffer.data(), 1, buffer.size(), gtf_file)) > 0)
+		for (size_t i = 0; i < bytes_read; ++i)
+			checksum = (checksum ^ buffer[i]) * 1099511628211ULL;
+	fclose(gtf_file);
+
+	ostringstream key;
+	key << checksum << "\n" << gtf_features << "\n";
+	for (contigs_t::const_iterator contig = contigs.begin(); contig != contigs.end(); ++contig)
+		key << contig->first << "\t" << contig->second << "\t" << original_contig_names[contig->second] << "\t" << assembly.length(contig->second) << "\n";
+	return key.str();
+}
+
+bool read_annotation_cache(const string& cache_file_path, const string& cache_key, contigs_t& contigs, vector<string>& original_contig_names, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names, gene_annotation_index_t& gene_annotation_index, exon_annotation_index_t& exon_annotation_index) {
+
+	FILE* file = fopen(cache_file_path.c_str(), "rb");
+	if (file == NULL)
+		return false; // no cache yet
+
+	// check if the cache was made from the same input
+	char signature[sizeof(ANNOTATION_CACHE_SIGNATURE)];
+	string key;
+	if (fread(signature, sizeof(signature), 1, file) != 1 || memcmp(signature, ANNOTATION_CACHE_SIGNATURE, sizeof(signature)) != 0) {
+		fclose(file);
+		return false;
+	}
+	read_annotation_cache_value(file, key);
+	if (key != cache_key) {
+		fclose(file);
+		return false;
+	}
+
+	// contigs which were added by the GTF file
+	uint32_t contig_count;
+	read_annotation_cache_value(file, contig_count);
+	contigs.clear();
+	original_contig_names.resize(contig_count);
+	for (uint32_t i = 0; i < contig_count; ++i) {
+		string contig_name;
+		read_annotation_cache_value(file, contig_name);
+		contig_t contig;
+		read_annotation_cache_value(file, contig);
+		crash(contig >= contig_count, "malformed annotation cache");
+		contigs[contig_name] = contig;
+		read_annotation_cache_value(file, original_contig_names[contig]);
+	}
+
+	// load records and resolve references between them once all records are loaded
+	uint32_t gene_count, transcript_count, exon_count;
+	read_annotation_cache_value(file, gene_count);
+	read_annotation_cache_value(file, transcript_count);
+	read_annotation_cache_value(file, exon_count);
+	vector<bool> removed_genes(gene_count), removed_exons(exon_count);
+	gene_annotation.clear();
+	for (uint32_t i = 0; i < gene_count; ++i) {
+		gene_annotation_record_t gene;
+		bool removed;
+		read_annotation_cache_value(file, removed);
+		removed_genes[i] = removed;
+		read_annotation_cache_value(file, gene.contig);
+		read_annotation_cache_value(file, gene.start);
+		read_annotation_cache_value(file, gene.end);
+		read_annotation_cache_value(file, gene.strand);
+		read_annotation_cache_value(file, gene.id);
+		read_annotation_cache_value(file, gene.gene_id);
+		read_annotation_cache_value(file, gene.name);
+		read_annotation_cache_value(file, gene.exonic_length);
+		read_annotation_cache_value(file, gene.is_dummy);
+		read_annotation_cache_value(file, gene.is_protein_coding);
+		gene_annotation.push_back(gene);
+	}
+	transcript_annotation.clear();
+	vector< pair<uint32_t,uint32_t> > transcript_exons(transcript_count);
+	for (uint32_t i = 0; i < transcript_count; ++i) {
+		transcript_annotation_record_t transcript;
+		read_annotation_cache_value(file, transcript.id);
+		read_annotation_cache_value(file, transcript.name);
+		read_annotation_cache_value(file, transcript_exons[i].first);
+		read_annotation_cache_value(file, transcript_exons[i].second);
+		transcript_annotation.push_back(transcript);
+	}
+	exon_annotation.clear();
+	vector< pair<uint32_t,uint32_t> > neighboring_exons(exon_count);
+	for (uint32_t i = 0; i < exon_count; ++i) {
+		exon_annotation_record_t exon;
+		bool removed;
+		read_annotation_cache_value(file, removed);
+		removed_exons[i] = removed;
+		read_annotation_cache_value(file, exon.contig);
+		read_annotation_cache_value(file, exon.start);
+		read_annotation_cache_value(file, exon.end);
+		read_annotation_cache_value(file, exon.strand);
+		uint32_t gene, transcript;
+		read_annotation_cache_value(file, gene);
+		read_annotation_cache_value(file, transcript);
+		exon.gene = get_record(gene_annotation, gene);
+		exon.transcript = get_record(transcript_annotation, transcript);
+		read_annotation_cache_value(file, neighboring_exons[i].first);
+		read_annotation_cache_value(file, neighboring_exons[i].second);
+		read_annotation_cache_value(file, exon.coding_region_start);
+		read_annotation_cache_value(file, exon.coding_region_end);
+		exon_annotation.push_back(exon);
+	}
+	for (uint32_t i = 0; i < transcript_count; ++i) {
+		transcript_annotation[i].first_exon = get_record(exon_annotation, transcript_exons[i].first);
+		transcript_annotation[i].last_exon = get_record(exon_annotation, transcript_exons[i].second);
+	}
+	for (uint32_t i = 0; i < exon_count; ++i) {
+		exon_annotation[i].previous_exon = get_record(exon_annotation, neighboring_exons[i].first);
+		exon_annotation[i].next_exon = get_record(exon_annotation, neighboring_exons[i].second);
+	}
+
+	// records which were removed due to malformed annotation leave gaps, which are referenced by other records
+	for (uint32_t i = 0; i < gene_count; ++i)
+		if (removed_genes[i])
+			gene_annotation.erase(gene_annotation_t::iterator(&gene_annotation, i));
+	for (uint32_t i = 0; i < exon_count; ++i)
+		if (removed_exons[i])
+			exon_annotation.erase(exon_annotation_t::iterator(&exon_annotation, i));
+
+	read_annotation_index_from_cache(file, gene_annotation_index, gene_annotation);
+	read_annotation_index_from_cache(file, exon_annotation_index, exon_annotation);
+	fclose(file);
+
+	// make a map of gene_name -> gene
+	gene_names.clear();
+	for (gene_annotation_t::iterator gene = gene_annotation.begin(); gene != gene_annotation.end(); ++gene)
+		gene_names[gene->name] = &(*gene);
+
+	return true;
+}
+
+void write_annotation_cache(const string& cache_file_path, const string& cache_key, const contigs_t& contigs, const vector<string>& original_contig_names, const gene_annotation_t& gene_annotation, const transcript_annotation_t& transcript_annotation, const exon_annotation_t& exon_annotation, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index) {
+
+	// write to a temporary file first, such that concurrent runs never see an incomplete cache
+	string temporary_file_path = cache_file_path + ".tmp" + to_string(static_cast<long long int>(getpid()));
+	FILE* file = fopen(temporary_file_path.c_str(), "wb");
+	crash(file == NULL, "failed to open annotation cache for writing: " + temporary_file_path);
+
+	crash(fwrite(ANNOTATION_CACHE_SIGNATURE, sizeof(ANNOTATION_CACHE_SIGNATURE), 1, file) != 1, "failed to write annotation cache");
+	write_annotation_cache_value(file, cache_key);
+
+	write_annotation_cache_value(file, (uint32_t) contigs.size());
+	for (contigs_t::const_iterator contig = contigs.begin(); contig != contigs.end(); ++contig) {
+		write_annotation_cache_value(file, contig->first);
+		write_annotation_cache_value(file, contig->second);
+		write_annotation_cache_value(file, original_contig_names[contig->second]);
+	}
+
+	unordered_map<const gene_annotation_record_t*,uint32_t> gene_indices = get_record_indices(gene_annotation);
+	unordered_map<const transcript_annotation_record_t*,uint32_t> transcript_indices = get_record_indices(transcript_annotation);
+	unordered_map<const exon_annotation_record_t*,uint32_t> exon_indices = get_record_indices(exon_annotation);
+	write_annotation_cache_value(file, gene_annotation.slots());
+	write_annotation_cache_value(file, transcript_annotation.slots());
+	write_annotation_cache_value(file, exon_annotation.slots());
+	for (uint32_t i = 0; i < gene_annotation.slots(); ++i) {
+		const gene_annotation_record_t& gene = gene_annotation[i];
+		write_annotation_cache_value(file, gene_annotation.is_removed(i));
+		write_annotation_cache_value(file, gene.contig);
+		write_annotation_cache_value(file, gene.start);
+		write_annotation_cache_value(file, gene.end);
+		write_annotation_cache_value(file, gene.strand);
+		write_annotation_cache_value(file, gene.id);
+		write_annotation_cache_value(file, gene.gene_id);
+		write_annotation_cache_value(file, gene.name);
+		write_annotation_cache_value(file, gene.exonic_length);
+		write_annotation_cache_value(file, gene.is_dummy);
+		write_annotation_cache_value(file, gene.is_protein_coding);
+	}
+	for (uint32_t i = 0; i < transcript_annotation.slots(); ++i) {
+		const transcript_annotation_record_t& transcript = transcript_annotation[i];
+		write_annotation_cache_value(file, transcript.id);
+		write_annotation_cache_value(file, transcript.name);
+		write_annotation_cache_value(file, get_record_index(exon_indices, (const exon_annotation_record_t*) transcript.first_exon));
+		write_annotation_cache_value(file, get_record_index(exon_indices, (const exon_annotation_record_t*) transcript.last_exon));
+	}
+	for (uint32_t i = 0; i < exon_annotation.slots(); ++i) {
+		const exon_annotation_record_t& exon = exon_annotation[i];
+		write_annotation_cache_value(file, exon_annotation.is_removed(i));
+		write_annotation_cache_value(file, exon.contig);
+		write_annotation_cache_value(file, exon.start);
+		write_annotation_cache_value(file, exon.end);
+		write_annotation_cache_value(file, exon.strand);
+		write_annotation_cache_value(file, get_record_index(gene_indices, (const gene_annotation_record_t*) exon.gene));
+		write_annotation_cache_value(file, get_record_index(transcript_indices, (const transcript_annotation_record_t*) exon.transcript));
+		write_annotation_cache_value(file, get_record_index(exon_indices, (const exon_annotation_record_t*) exon.previous_exon));
+		write_annotation_cache_value(file, get_record_index(exon_indices, (const exon_annotation_record_t*) exon.next_exon));
+		write_annotation_cache_value(file, exon.coding_region_start);
+		write_annotation_cache_value(file, exon.coding_region_end);
+	}
+
+	write_annotation_index_to_cache(file, gene_annotation_index, gene_indices);
+	write_annotation_index_to_cache(file, exon_annotation_index, exon_indices);
+
+	crash(fclose(file) != 0, "failed to write annotation cache");
+	crash(rename(temporary_file_path.c_str(), cache_file_path.c_str()) != 0, "failed to write annotation cache: " + cache_file_path);
+}
@@ -32,7 +32,13 @@ inline string strip_ensembl_version_number(const string& ensembl_identifier) {
 		return ensembl_identifier;
 }
 
-void read_annotation_gtf(const string& filename, const string& gtf_features_string, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names);
+void read_annotation_gtf(const string& filename, const string& gtf_features_string, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names, const unsigned int threads);
+
+string get_annotation_cache_key(const string& gtf_file_path, const string& gtf_features, const contigs_t& contigs, const vector<string>& original_contig_names, const assembly_t& assembly);
+
+bool read_annotation_cache(const string& cache_file_path, const string& cache_key, contigs_t& contigs, vector<string>& original_contig_names, gene_annotation_t& gene_annotation, transcript_annotation_t& transcript_annotation, exon_annotation_t& exon_annotation, unordered_map<string,gene_t>& gene_names, gene_annotation_index_t& gene_annotation_index, exon_annotation_index_t& exon_annotation_index);
+
+void write_annotation_cache(const string& cache_file_path, const string& cache_key, const contigs_t& contigs, const vector<string>& original_contig_names, const gene_annotation_t& gene_annotation, const transcript_annotation_t& transcript_annotation, const exon_annotation_t& exon_annotation, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index);
 
 template <class T> void make_annotation_index(annotation_t<T>& annotation, annotation_index_t<T*>& annotation_index, const contigs_t& contigs);
 
@@ -40,11 +46,13 @@ bool is_breakpoint_spliced(const gene_t gene, const direction_t direction, const
 
 template <class T> void combine_annotations(const annotation_set_t<T>& genes1, const annotation_set_t<T>& genes2, annotation_set_t<T>& combined, bool make_union = true);
 
+void combine_annotations(const interned_gene_set_t& genes1, const interned_gene_set_t& genes2, interned_gene_set_t& combined, bool make_union = true);
+
 template <class T> void get_annotation_by_coordinate(const contig_t contig, const position_t start, const position_t end, annotation_set_t<T>& annotation_set, const annotation_index_t<T>& annotation_index);
 
 void annotate_alignments(mates_t& mates, const exon_annotation_index_t& exon_annotation_index);
 
-void get_boundaries_of_biggest_gene(gene_set_t& genes, position_t& start, position_t& end);
+void get_boundaries_of_biggest_gene(const gene_set_t& genes, position_t& start, position_t& end);
 
 int get_spliced_distance(const contig_t contig, const position_t position1, const position_t position2, const gene_t gene, const exon_annotation_index_t& exon_annotation_index);
 
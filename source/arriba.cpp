@@ -9,6 +9,8 @@
 #include <sys/resource.h>
 #include <unordered_map>
 #include <vector>
+#include "hts.h"
+#include "thread_pool.h"
 #include "common.hpp"
 #include "annotation.hpp"
 #include "assembly.hpp"
@@ -92,39 +94,84 @@ int main(int argc, char **argv) {
 	vector<string> original_contig_names; // "chr" prefix is removed from contig names to ensure compatibility between assembly and annotation; this vector stores the original names
 	cout << get_time_string() << " Loading assembly from '" << options.assembly_file << "' " << endl;
 	assembly_t assembly;
-	load_assembly(assembly, options.assembly_file, contigs, original_contig_names, options.interesting_contigs);
+	load_assembly(assembly, options.assembly_file, contigs, original_contig_names, options.binary_assembly_file.empty() ? options.interesting_contigs : "*", options.load_assembly_on_demand);
+	if (!options.binary_assembly_file.empty()) {
+		cout << get_time_string() << " Writing binary assembly to '" << options.binary_assembly_file << "' " << endl << flush;
+		write_binary_assembly(assembly, options.binary_assembly_file, original_contig_names);
+		// the binary assembly contains all contigs, but only the interesting ones are needed for this run
+		for (contigs_t::iterator contig = contigs.begin(); contig != contigs.end(); ++contig)
+			if (!is_interesting_contig(contig->first, options.interesting_contigs))
+				assembly.erase(contig->second);
+	}
 
 	// load GTF file
 	// must be loaded after assembly to check if genes exceed the boundaries of contigs
-	cout << get_time_string() << " Loading annotation from '" << options.gene_annotation_file << "' " << endl << flush;
 	gene_annotation_t gene_annotation;
 	transcript_annotation_t transcript_annotation;
 	exon_annotation_t exon_annotation;
 	unordered_map<string,gene_t> gene_names;
-	read_annotation_gtf(options.gene_annotation_file, options.gtf_features, contigs, original_contig_names, assembly, gene_annotation, transcript_annotation, exon_annotation, gene_names);
-
-	// sort genes and exons by coordinate (make index)
 	exon_annotation_index_t exon_annotation_index;
-	make_annotation_index(exon_annotation, exon_annotation_index);
 	gene_annotation_index_t gene_annotation_index;
-	make_annotation_index(gene_annotation, gene_annotation_index);
+	string annotation_cache_key;
+	if (!options.annotation_cache_file.empty())
+		annotation_cache_key = get_annotation_cache_key(options.gene_annotation_file, options.gtf_features, contigs, original_contig_names, assembly);
+	if (!options.annotation_cache_file.empty() && read_annotation_cache(options.annotation_cache_file, annotation_cache_key, contigs, original_contig_names, gene_annotation, transcript_annotation, exon_annotation, gene_names, gene_annotation_index, exon_annotation_index)) {
+		cout << get_time_string() << " Loaded annotation from cache '" << options.annotation_cache_file << "' " << endl << flush;
+	} else {
+		cout << get_time_string() << " Loading annotation from '" << options.gene_annotation_file << "' " << endl << flush;
+		read_annotation_gtf(options.gene_annotation_file, options.gtf_features, contigs, original_contig_names, assembly, gene_annotation, transcript_annotation, exon_annotation, gene_names, options.threads);
+
+		// sort genes and exons by coordinate (make index)
+		make_annotation_index(exon_annotation, exon_annotation_index);
+		make_annotation_index(gene_annotation, gene_annotation_index);
+
+		if (!options.annotation_cache_file.empty()) {
+			cout << get_time_string() << " Writing annotation cache to '" << options.annotation_cache_file << "' " << endl << flush;
+			write_annotation_cache(options.annotation_cache_file, annotation_cache_key, contigs, original_contig_names, gene_annotation, transcript_annotation, exon_annotation, gene_annotation_index, exon_annotation_index);
+		}
+	}
 
 	// prevent htslib from downloading the assembly via the Internet, if CRAM is used
 	setenv("REF_PATH", ".", 0);
 
+	// decompress input files using a pool of threads, which is shared between all input files
+	// the threads are split between decompression and the extraction of chimeric reads, which run concurrently
+	htsThreadPool thread_pool = { NULL, 0 };
+	unsigned int extraction_threads = max(1U, options.threads / 2);
+	if (options.threads > 1) {
+		thread_pool.pool = hts_tpool_init(max(1U, options.threads - extraction_threads));
+		crash(thread_pool.pool == NULL, "failed to create thread pool");
+	}
+
 	// load chimeric alignments
 	chimeric_alignments_t chimeric_alignments;
 	unsigned long int mapped_reads = 0;
 	vector<unsigned long int> mapped_viral_reads_by_contig;
 	coverage_t coverage;
+	coverage.set_resolution(options.coverage_resolution);
 	if (!options.chimeric_bam_file.empty()) { // when STAR was run with --chimOutType SeparateSAMold, chimeric alignments must be read from a separate file named Chimeric.out.sam
 		cout << get_time_string() << " Reading chimeric alignments from '" << options.chimeric_bam_file << "' " << flush;
-		cout << "(total=" << read_chimeric_alignments(options.chimeric_bam_file, assembly, options.assembly_file, chimeric_alignments, mapped_reads, mapped_viral_reads_by_contig, coverage, contigs, original_contig_names, options.interesting_contigs, options.viral_contigs, gene_annotation_index, true, false, options.external_duplicate_marking, options.max_itd_length) << ")" << endl;
+		cout << "(total=" << read_chimeric_alignments(options.chimeric_bam_file, assembly, options.assembly_file, chimeric_alignments, mapped_reads, mapped_viral_reads_by_contig, coverage, contigs, original_contig_names, options.interesting_contigs, options.viral_contigs, gene_annotation_index, true, false, options.external_duplicate_marking, options.max_itd_length, extraction_threads, thread_pool) << ")" << endl;
 	}
 
-	// extract chimeric alignments and read-through alignments from Aligned.out.bam
-	cout << get_time_string() << " Reading chimeric alignments from '" << options.rna_bam_file << "' " << flush;
-	cout << "(total=" << read_chimeric_alignments(options.rna_bam_file, assembly, options.assembly_file, chimeric_alignments, mapped_reads, mapped_viral_reads_by_contig, coverage, contigs, original_contig_names, options.interesting_contigs, options.viral_contigs, gene_annotation_index, !options.chimeric_bam_file.empty(), true, options.external_duplicate_marking, options.max_itd_length) << ")" << endl;
+	if (!options.coverage_file.empty()) {
+		// take coverage from a previous run instead of reading Aligned.out.bam
+		cout << get_time_string() << " Loading coverage from '" << options.coverage_file << "' " << flush;
+		coverage.read_from_file(options.coverage_file, contigs, original_contig_names, assembly, options.coverage_resolution_given, mapped_reads, mapped_viral_reads_by_contig);
+		cout << "(mapped_reads=" << mapped_reads << ")" << endl;
+	} else {
+		// extract chimeric alignments and read-through alignments from Aligned.out.bam
+		cout << get_time_string() << " Reading chimeric alignments from '" << options.rna_bam_file << "' " << flush;
+		cout << "(total=" << read_chimeric_alignments(options.rna_bam_file, assembly, options.assembly_file, chimeric_alignments, mapped_reads, mapped_viral_reads_by_contig, coverage, contigs, original_contig_names, options.interesting_contigs, options.viral_contigs, gene_annotation_index, !options.chimeric_bam_file.empty(), true, options.external_duplicate_marking, options.max_itd_length, extraction_threads, thread_pool) << ")" << endl;
+	}
+
+	if (!options.coverage_output_file.empty()) {
+		cout << get_time_string() << " Writing coverage to '" << options.coverage_output_file << "' " << endl << flush;
+		coverage.write_to_file(options.coverage_output_file, contigs, original_contig_names, mapped_reads, mapped_viral_reads_by_contig);
+	}
+
+	if (thread_pool.pool != NULL)
+		hts_tpool_destroy(thread_pool.pool);
 
 	// convert viral contigs to vector of booleans for faster lookup
 	vector<bool> viral_contigs(contigs.size());
@@ -187,12 +234,15 @@ int main(int argc, char **argv) {
 	// if the alignment does not map to an exon, try to map it to a gene
 	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
 		for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
-			if (mate->genes.empty())
-				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, mate->genes, gene_annotation_index);
+			if (mate->genes.empty()) {
+				gene_set_t genes;
+				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, genes, gene_annotation_index);
+				mate->genes = genes;
+			}
 		}
 		// try to resolve ambiguous mappings using mapping information from mate
 		if (chimeric_alignment->second.size() == 3) {
-			gene_set_t combined;
+			interned_gene_set_t combined;
 			combine_annotations(chimeric_alignment->second[SPLIT_READ].genes, chimeric_alignment->second[MATE1].genes, combined);
 			if (chimeric_alignment->second[MATE1].genes.empty() || combined.size() < chimeric_alignment->second[MATE1].genes.size())
 				chimeric_alignment->second[MATE1].genes = combined;
@@ -261,8 +311,11 @@ int main(int argc, char **argv) {
 	make_annotation_index(gene_annotation, gene_annotation_index); // index needs to be regenerated after adding dummy genes
 	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
 		for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
-			if (mate->genes.empty())
-				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, mate->genes, gene_annotation_index);
+			if (mate->genes.empty()) {
+				gene_set_t genes;
+				get_annotation_by_coordinate(mate->contig, mate->start, mate->end, genes, gene_annotation_index);
+				mate->genes = genes;
+			}
 		}
 		if (chimeric_alignment->second.size() == 3) // split-read
 			if (chimeric_alignment->second[MATE1].genes.empty()) // copy dummy gene from split-read, if mate1 still has no annotation
@@ -379,6 +432,10 @@ int main(int argc, char **argv) {
 		cout << "(remaining=" << filter_multimappers(chimeric_alignments, fusions, exon_annotation_index, assembly) << ")" << endl;
 	}
 
+	// this step must come after the 'multimappers' filter, which compares the alignments of all reads
+	cout << get_time_string() << " Releasing alignments of reads which do not support any fusion " << flush;
+	cout << "(freed=" << (release_unused_alignments(chimeric_alignments, fusions) / 1024) << "kb)" << endl;
+
 	// this step must come after the 'merge_adjacent' filter,
 	// because STAR clips reads supporting the same breakpoints at different position
 	// and that spreads the supporting reads over multiple breakpoints
@@ -1,8 +1,14 @@
 #include <climits>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "sam.h"
 #include "common.hpp"
 #include "annotation.hpp"
@@ -25,7 +31,274 @@ string dna_to_reverse_complement(const string& dna) {
 	return reverse_complement;
 }
 
-void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs) {
+// binary assembly format:
+// - signature
+// - number of contigs (uint32)
+// - for each contig: length of name (uint32), name, length of sequence (uint32), number of runs of non-ACGT bases (uint32), file offset of sequence data (uint64)
+// - for each contig: runs of non-ACGT bases (binary_assembly_run_t), followed by the bases packed into 2 bits each (A=0, C=1, G=2, T=3)
+const char BINARY_ASSEMBLY_SIGNATURE[] = "ARRIBA_2BIT_1";
+
+bool is_binary_assembly(const string& file_path) {
+	char signature[sizeof(BINARY_ASSEMBLY_SIGNATURE)] = {};
+	FILE* file = fopen(file_path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	bool result = fread(signature, sizeof(signature), 1, file) == 1 && memcmp(signature, BINARY_ASSEMBLY_SIGNATURE, sizeof(signature)) == 0;
+	fclose(file);
+	return result;
+}
+
+template <class T> void write_binary_assembly_value(FILE* file, const T* value, const size_t count = 1) {
+	crash(count > 0 && fwrite(value, sizeof(T), count, file) != count, "failed to write binary assembly");
+}
+
+void write_binary_assembly(const assembly_t& assembly, const string& output_file, const vector<string>& original_contig_names) {
+
+	// find runs of non-ACGT bases (mostly N) of all contigs
+	vector< vector<binary_assembly_run_t> > runs(original_contig_names.size());
+	for (contig_t contig = 0; contig < original_contig_names.size(); ++contig) {
+		if (!assembly.count(contig))
+			continue;
+		contig_sequence_t sequence = assembly.at(contig);
+		crash(sequence.size() > UINT_MAX, "contig too long for binary assembly");
+		for (uint32_t position = 0; position < sequence.size(); ++position) {
+			char base = sequence[position];
+			if (base != 'A' && base != 'C' && base != 'G' && base != 'T') {
+				if (!runs[contig].empty() && runs[contig].back().start + runs[contig].back().length == position && runs[contig].back().base == (uint32_t) base)
+					runs[contig].back().length++;
+				else
+					runs[contig].push_back({ position, 1, (uint32_t) base });
+			}
+		}
+	}
+
+	FILE* file = fopen(output_file.c_str(), "wb");
+	crash(file == NULL, "failed to open binary assembly for writing: " + output_file);
+
+	// write table of contents
+	write_binary_assembly_value(file, BINARY_ASSEMBLY_SIGNATURE, sizeof(BINARY_ASSEMBLY_SIGNATURE));
+	uint32_t contig_count = original_contig_names.size();
+	write_binary_assembly_value(file, &contig_count);
+	uint64_t offset = sizeof(BINARY_ASSEMBLY_SIGNATURE) + sizeof(contig_count);
+	for (contig_t contig = 0; contig < original_contig_names.size(); ++contig)
+		offset += sizeof(uint32_t) + original_contig_names[contig].size() + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+	for (contig_t contig = 0; contig < original_contig_names.size(); ++contig) {
+		uint32_t name_length = original_contig_names[contig].size();
+		write_binary_assembly_value(file, &name_length);
+		write_binary_assembly_value(file, original_contig_names[contig].data(), name_length);
+		uint32_t sequence_length = (assembly.count(contig)) ? assembly.at(contig).size() : 0;
+		write_binary_assembly_value(file, &sequence_length);
+		uint32_t run_count = runs[contig].size();
+		write_binary_assembly_value(file, &run_count);
+		write_binary_assembly_value(file, &offset);
+		offset += run_count * sizeof(binary_assembly_run_t) + (sequence_length + 3) / 4;
+	}
+
+	// write sequences
+	vector<uint8_t> packed_bases;
+	for (contig_t contig = 0; contig < original_contig_names.size(); ++contig) {
+		write_binary_assembly_value(file, runs[contig].data(), runs[contig].size());
+		if (assembly.count(contig)) {
+			contig_sequence_t sequence = assembly.at(contig);
+			packed_bases.assign((sequence.size() + 3) / 4, 0);
+			for (size_t position = 0; position < sequence.size(); ++position) {
+				uint8_t base;
+				switch (sequence[position]) {
+					case 'C': base = 1; break;
+					case 'G': base = 2; break;
+					case 'T': base = 3; break;
+					default: base = 0; // non-ACGT bases are restored from the runs
+				}
+				packed_bases[position / 4] |= base << (2 * (position % 4));
+			}
+			write_binary_assembly_value(file, packed_bases.data(), packed_bases.size());
+		}
+	}
+
+	crash(fclose(file) != 0, "failed to write binary assembly");
+}
+
+// decoding table: one byte of packed bases => four bases
+struct binary_assembly_decoding_table_t {
+	char bases[256][4];
+	binary_assembly_decoding_table_t() {
+		for (unsigned int byte = 0; byte < 256; ++byte)
+			for (unsigned int i = 0; i < 4; ++i)
+				bases[byte][i] = "ACGT"[(byte >> (2 * i)) & 3];
+	};
+};
+const binary_assembly_decoding_table_t binary_assembly_decoding_table;
+
+void contig_sequence_t::copy(const size_t position, size_t count, string& destination) const {
+
+	crash(position > length, "position beyond the end of the contig");
+	count = min(count, length - position);
+	if (sequence != NULL) {
+		destination.assign(*sequence, position, count);
+		return;
+	}
+
+	// decode bases, four at a time where the range is aligned to the packed bytes
+	destination.resize(count);
+	size_t i = 0;
+	for (; i < count && (position + i) % 4 != 0; ++i)
+		destination[i] = binary_assembly_decoding_table.bases[packed_bases[(position + i) / 4]][(position + i) % 4];
+	for (; i + 4 <= count; i += 4)
+		memcpy(&destination[i], binary_assembly_decoding_table.bases[packed_bases[(position + i) / 4]], 4);
+	for (; i < count; ++i)
+		destination[i] = binary_assembly_decoding_table.bases[packed_bases[(position + i) / 4]][(position + i) % 4];
+
+	// restore non-ACGT bases which overlap the range
+	const binary_assembly_run_t* run = upper_bound(runs, runs + run_count, position, [](const size_t position, const binary_assembly_run_t& run) { return position < run.start; });
+	if (run != runs)
+		--run; // the preceding run may extend into the range
+	for (; run != runs + run_count && run->start < position + count; ++run) {
+		size_t run_start = max((size_t) run->start, position);
+		size_t run_end = min((size_t) run->start + run->length, position + count);
+		if (run_start < run_end)
+			memset(&destination[run_start - position], run->base, run_end - run_start);
+	}
+}
+
+// the binary assembly is mapped into memory rather than read, such that concurrent jobs share the file via the page cache
+// the mapping remains open and the bases are decoded from it whenever they are accessed
+void load_binary_assembly(assembly_t& assembly, const string& file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs) {
+
+	int file_descriptor = open(file_path.c_str(), O_RDONLY);
+	crash(file_descriptor == -1, "failed to open binary assembly: " + file_path);
+	struct stat file_info;
+	crash(fstat(file_descriptor, &file_info) != 0, "failed to open binary assembly: " + file_path);
+	const size_t file_size = file_info.st_size;
+	void* mapped_file = mmap(NULL, file_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+	crash(mapped_file == MAP_FAILED, "failed to map binary assembly into memory: " + file_path);
+	close(file_descriptor);
+	const char* data = (const char*) mapped_file;
+	assembly.set_binary_assembly(data, file_size);
+
+	size_t table_position = sizeof(BINARY_ASSEMBLY_SIGNATURE);
+	auto read_value = [&](void* value, const size_t size) {
+		crash(table_position + size > file_size, "binary assembly is truncated: " + file_path);
+		memcpy(value, data + table_position, size);
+		table_position += size;
+	};
+	uint32_t contig_count;
+	read_value(&contig_count, sizeof(contig_count));
+
+	for (uint32_t i = 0; i < contig_count; ++i) {
+		uint32_t name_length;
+		read_value(&name_length, sizeof(name_length));
+		string contig_name(name_length, '\0');
+		read_value(&contig_name[0], name_length);
+		uint32_t sequence_length;
+		read_value(&sequence_length, sizeof(sequence_length));
+		uint32_t run_count;
+		read_value(&run_count, sizeof(run_count));
+		uint64_t offset;
+		read_value(&offset, sizeof(offset));
+
+		crash(contigs.size() == USHRT_MAX - 1, "too many contigs");
+		pair<contigs_t::iterator,bool> new_contig = contigs.insert(pair<string,contig_t>(removeChr(contig_name), contigs.size()));
+		contig_t contig = new_contig.first->second;
+		if (original_contig_names.size() < contigs.size())
+			original_contig_names.resize(contigs.size());
+		original_contig_names[contig] = contig_name;
+		if (sequence_length == 0 || !is_interesting_contig(contig_name, interesting_contigs))
+			continue; // skip uninteresting contigs
+
+		crash(offset + run_count * sizeof(binary_assembly_run_t) + (sequence_length + 3) / 4 > file_size, "binary assembly is truncated: " + file_path);
+		assembly.add_binary_contig(contig, sequence_length, offset, run_count);
+	}
+}
+
+assembly_t::~assembly_t() {
+	if (binary_assembly != NULL)
+		munmap((void*) binary_assembly, binary_assembly_size);
+}
+
+void assembly_t::load_sequence(const contig_t contig, const contig_index_entry_t& contig_index_entry) const {
+
+	if (binary_assembly != NULL) {
+
+		// the bases are decoded on access, only the runs of non-ACGT bases are loaded
+		const size_t packed_length = (contig_index_entry.length + 3) / 4;
+		crash(contig_index_entry.offset + contig_index_entry.run_count * sizeof(binary_assembly_run_t) + packed_length > binary_assembly_size, "binary assembly is truncated");
+		contig_index_entry.runs.resize(contig_index_entry.run_count);
+		if (contig_index_entry.run_count > 0)
+			memcpy(contig_index_entry.runs.data(), binary_assembly + contig_index_entry.offset, contig_index_entry.run_count * sizeof(binary_assembly_run_t));
+		for (size_t run = 0; run < contig_index_entry.runs.size(); ++run)
+			crash((uint64_t) contig_index_entry.runs[run].start + contig_index_entry.runs[run].length > contig_index_entry.length ||
+			      run > 0 && contig_index_entry.runs[run].start < (uint64_t) contig_index_entry.runs[run-1].start + contig_index_entry.runs[run-1].length,
+			      "malformed binary assembly");
+
+	} else {
+
+		string& sequence = sequences.find(contig)->second;
+
+		// read all lines of the contig at once (up to the last base, since the last line need not end with a line break)
+		size_t bytes = 0;
+		if (contig_index_entry.length > 0)
+			bytes = (contig_index_entry.length - 1) / contig_index_entry.line_bases * contig_index_entry.line_bytes + (contig_index_entry.length - 1) % contig_index_entry.line_bases + 1;
+		string buffer(bytes, '\0');
+		FILE* fasta_file = fopen(fasta_file_path.c_str(), "rb");
+		crash(fasta_file == NULL, "failed to open assembly: " + fasta_file_path);
+		crash(fseek(fasta_file, contig_index_entry.offset, SEEK_SET) != 0 || fread(&buffer[0], 1, bytes, fasta_file) != bytes, "failed to read sequence from assembly (is the FastA index outdated?): " + fasta_file_path);
+		fclose(fasta_file);
+
+		// remove line breaks and convert sequence to uppercase
+		sequence.resize(contig_index_entry.length);
+		size_t position = 0;
+		for (size_t byte = 0; byte < bytes && position < contig_index_entry.length; ++byte)
+			if (buffer[byte] != '\n' && buffer[byte] != '\r')
+				sequence[position++] = toupper(buffer[byte]);
+		crash(position != contig_index_entry.length, "FastA index does not match assembly: " + fasta_file_path);
+	}
+}
+
+// only read the FastA index (.fai) and defer loading the sequences until they are accessed
+void load_assembly_index(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs) {
+
+	// random access is only possible in uncompressed files
+	FILE* fasta_file = fopen(fasta_file_path.c_str(), "rb");
+	crash(fasta_file == NULL, "failed to open assembly: " + fasta_file_path);
+	int first_byte = fgetc(fasta_file);
+	fclose(fasta_file);
+	crash(first_byte != '>', "loading the assembly on demand requires an uncompressed FastA file: " + fasta_file_path);
+
+	crash(access((fasta_file_path + ".fai").c_str(), R_OK), "index file not found/readable: " + fasta_file_path + ".fai");
+	autodecompress_file_t fasta_index_file(fasta_file_path + ".fai");
+	string line;
+	while (fasta_index_file.getline(line)) {
+		if (!line.empty()) {
+			istringstream iss(line);
+			string contig_name;
+			size_t length, line_bases, line_bytes;
+			long int offset;
+			iss >> contig_name >> length >> offset >> line_bases >> line_bytes;
+			crash(iss.fail() || length > 0 && (line_bases == 0 || line_bytes <= line_bases), "malformed line in FastA index: " + line);
+
+			crash(contigs.size() == USHRT_MAX - 1, "too many contigs");
+			pair<contigs_t::iterator,bool> new_contig = contigs.insert(pair<string,contig_t>(removeChr(contig_name), contigs.size()));
+			contig_t contig = new_contig.first->second;
+			if (original_contig_names.size() < contigs.size())
+				original_contig_names.resize(contigs.size());
+			original_contig_names[contig] = contig_name;
+			if (length > 0 && is_interesting_contig(contig_name, interesting_contigs)) // skip uninteresting contigs
+				assembly.add_indexed_contig(contig, fasta_file_path, length, offset, line_bases, line_bytes);
+		}
+	}
+}
+
+void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs, const bool load_on_demand) {
+
+	if (is_binary_assembly(fasta_file_path)) {
+		load_binary_assembly(assembly, fasta_file_path, contigs, original_contig_names, interesting_contigs);
+		return;
+	}
+
+	if (load_on_demand) {
+		load_assembly_index(assembly, fasta_file_path, contigs, original_contig_names, interesting_contigs);
+		return;
+	}
 
 	// read FastA file line by line
 	autodecompress_file_t fasta_file(fasta_file_path);
@@ -24,6 +24,10 @@ void dna_to_reverse_complement(const string& dna, string& reverse_complement);
 
 string dna_to_reverse_complement(const string& dna);
 
-void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs);
+bool is_binary_assembly(const string& file_path);
+
+void write_binary_assembly(const assembly_t& assembly, const string& output_file, const vector<string>& original_contig_names);
+
+void load_assembly(assembly_t& assembly, const string& fasta_file_path, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs, const bool load_on_demand);
 
 #endif /* _ASSEMBLY_H */
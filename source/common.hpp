@@ -5,8 +5,11 @@
 #include <climits>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <sstream>
@@ -108,7 +111,108 @@ inline bool is_interesting_contig(string contig, const string& interesting_conti
 	return false;
 };
 
-typedef unordered_map<contig_t,string> assembly_t;
+// run of non-ACGT bases in a binary assembly, which cannot be packed into 2 bits
+struct binary_assembly_run_t {
+	uint32_t start;
+	uint32_t length;
+	uint32_t base;
+};
+
+// read-only view of the sequence of a contig
+// the bases of a binary assembly are decoded on demand from the memory-mapped file rather than being copied
+class contig_sequence_t {
+	private:
+		const string* sequence; // NULL, if the bases are taken from a binary assembly
+		const uint8_t* packed_bases;
+		const binary_assembly_run_t* runs; // sorted by start
+		size_t run_count;
+		size_t length;
+	public:
+		contig_sequence_t(const string& sequence): sequence(&sequence), packed_bases(NULL), runs(NULL), run_count(0), length(sequence.size()) {};
+		contig_sequence_t(const uint8_t* packed_bases, const binary_assembly_run_t* runs, const size_t run_count, const size_t length): sequence(NULL), packed_bases(packed_bases), runs(runs), run_count(run_count), length(length) {};
+		size_t size() const { return length; };
+		char operator[](const size_t position) const {
+			if (sequence != NULL)
+				return (*sequence)[position];
+			const binary_assembly_run_t* run = upper_bound(runs, runs + run_count, position, [](const size_t position, const binary_assembly_run_t& run) { return position < run.start; });
+			if (run != runs && position < (size_t) (run-1)->start + (run-1)->length)
+				return (run-1)->base;
+			return "ACGT"[(packed_bases[position / 4] >> (2 * (position % 4))) & 3];
+		};
+		void copy(const size_t position, size_t count, string& destination) const; // decodes a range of bases at once, much faster than operator[]
+		string substr(const size_t position, const size_t count = string::npos) const { string result; copy(position, count, result); return result; };
+};
+
+// sequences of the contigs, indexed by contig
+// when the assembly is loaded via a FastA index, the sequence of a contig is only read from disk when it is first accessed
+// the sequences of a binary assembly are never copied, but accessed via contig_sequence_t
+class assembly_t {
+	private:
+		typedef unordered_map<contig_t,string> sequences_t;
+		// location of a contig which is loaded on demand, either from a FastA file or from a memory-mapped binary assembly
+		struct contig_index_entry_t {
+			size_t length; // number of bases
+			long int offset; // file offset of the first base (FastA) or of the runs of non-ACGT bases (binary assembly)
+			size_t line_bases; // number of bases per line (FastA only)
+			size_t line_bytes; // number of bytes per line including the line break (FastA only)
+			size_t run_count; // number of runs of non-ACGT bases (binary assembly only)
+			mutable vector<binary_assembly_run_t> runs; // copied from the binary assembly, since they may be misaligned in the file
+			mutable once_flag loaded;
+		};
+		mutable sequences_t sequences; // contigs which have not been loaded yet and contigs of a binary assembly have an empty sequence
+		unordered_map<contig_t,contig_index_entry_t> contig_index; // only contains contigs which are loaded lazily
+		string fasta_file_path;
+		const char* binary_assembly; // memory-mapped binary assembly or NULL, if the assembly was loaded from a FastA file
+		size_t binary_assembly_size;
+		void load_sequence(const contig_t contig, const contig_index_entry_t& contig_index_entry) const;
+	public:
+		assembly_t(): binary_assembly(NULL), binary_assembly_size(0) {};
+		~assembly_t(); // unmaps the binary assembly
+		string& operator[](const contig_t contig) { return sequences[contig]; };
+		contig_sequence_t at(const contig_t contig) const { // throws out_of_range, if the contig is not in the assembly
+			auto contig_index_entry = contig_index.find(contig);
+			if (contig_index_entry == contig_index.end())
+				return contig_sequence_t(sequences.at(contig));
+			// thread-safe, because reads may be processed in parallel
+			call_once(contig_index_entry->second.loaded, &assembly_t::load_sequence, this, contig, cref(contig_index_entry->second));
+			if (binary_assembly == NULL)
+				return contig_sequence_t(sequences.at(contig));
+			const contig_index_entry_t& binary_contig = contig_index_entry->second;
+			return contig_sequence_t((const uint8_t*) binary_assembly + binary_contig.offset + binary_contig.run_count * sizeof(binary_assembly_run_t), binary_contig.runs.data(), binary_contig.runs.size(), binary_contig.length);
+		};
+		size_t count(const contig_t contig) const { return sequences.count(contig); }; // does not load the sequence
+		size_t length(const contig_t contig) const { // does not load the sequence
+			auto contig_index_entry = contig_index.find(contig);
+			if (contig_index_entry != contig_index.end())
+				return contig_index_entry->second.length;
+			sequences_t::const_iterator sequence = sequences.find(contig);
+			return (sequence == sequences.end()) ? 0 : sequence->second.size();
+		};
+		void erase(const contig_t contig) { sequences.erase(contig); contig_index.erase(contig); };
+		void add_indexed_contig(const contig_t contig, const string& fasta_file_path, const size_t length, const long int offset, const size_t line_bases, const size_t line_bytes) {
+			this->fasta_file_path = fasta_file_path;
+			sequences[contig];
+			contig_index_entry_t& contig_index_entry = contig_index[contig];
+			contig_index_entry.length = length;
+			contig_index_entry.offset = offset;
+			contig_index_entry.line_bases = line_bases;
+			contig_index_entry.line_bytes = line_bytes;
+			contig_index_entry.run_count = 0;
+		};
+		void set_binary_assembly(const char* binary_assembly, const size_t binary_assembly_size) {
+			this->binary_assembly = binary_assembly;
+			this->binary_assembly_size = binary_assembly_size;
+		};
+		void add_binary_contig(const contig_t contig, const size_t length, const long int offset, const size_t run_count) {
+			sequences[contig];
+			contig_index_entry_t& contig_index_entry = contig_index[contig];
+			contig_index_entry.length = length;
+			contig_index_entry.offset = offset;
+			contig_index_entry.line_bases = 0;
+			contig_index_entry.line_bytes = 0;
+			contig_index_entry.run_count = run_count;
+		};
+};
 
 struct annotation_record_t {
 	contig_t contig;
@@ -140,7 +244,85 @@ template <class T> class annotation_set_t: public vector<T> {
 		};
 		using vector<T>::insert;
 };
-template <class T> class annotation_t: public list<T> {};
+// annotation records are stored contiguously in chunks of fixed capacity, which are never reallocated,
+// such that records can be referenced by pointers (gene_t, exon_t, ...) and by a stable 32-bit index
+// removed records leave a gap, which is skipped during iteration
+template <class T> class annotation_t {
+	private:
+		static const unsigned int CHUNK_BITS = 12;
+		static const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+		vector< vector<T> > chunks;
+		vector<bool> removed;
+		uint32_t removed_count;
+	public:
+		template <class annotation_type, class record_type> class iterator_t {
+			private:
+				annotation_type* annotation;
+				uint32_t position;
+				void skip_removed() { while (position < annotation->removed.size() && annotation->removed[position]) ++position; };
+			public:
+				typedef forward_iterator_tag iterator_category;
+				typedef record_type value_type;
+				typedef ptrdiff_t difference_type;
+				typedef record_type* pointer;
+				typedef record_type& reference;
+				iterator_t(): annotation(NULL), position(0) {};
+				iterator_t(annotation_type* annotation, const uint32_t position): annotation(annotation), position(position) { skip_removed(); };
+				template <class other_annotation_type, class other_record_type> iterator_t(const iterator_t<other_annotation_type,other_record_type>& other): annotation(other.get_annotation()), position(other.get_index()) {};
+				annotation_type* get_annotation() const { return annotation; };
+				uint32_t get_index() const { return position; };
+				record_type& operator*() const { return (*annotation)[position]; };
+				record_type* operator->() const { return &(*annotation)[position]; };
+				iterator_t& operator++() { ++position; skip_removed(); return *this; };
+				iterator_t operator++(int) { iterator_t result = *this; ++(*this); return result; };
+				bool operator==(const iterator_t& other) const { return position == other.position; };
+				bool operator!=(const iterator_t& other) const { return position != other.position; };
+		};
+		typedef T value_type;
+		typedef iterator_t<annotation_t<T>,T> iterator;
+		typedef iterator_t<const annotation_t<T>,const T> const_iterator;
+		annotation_t(): removed_count(0) {};
+		T& operator[](const uint32_t index) { return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; };
+		const T& operator[](const uint32_t index) const { return chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; };
+		iterator begin() { return iterator(this, 0); };
+		iterator end() { return iterator(this, removed.size()); };
+		const_iterator begin() const { return const_iterator(this, 0); };
+		const_iterator end() const { return const_iterator(this, removed.size()); };
+		size_t size() const { return removed.size() - removed_count; };
+		bool empty() const { return size() == 0; };
+		uint32_t slots() const { return removed.size(); }; // number of records including removed ones
+		bool is_removed(const uint32_t index) const { return removed[index]; };
+		T& back() { return (*this)[removed.size() - 1]; };
+		void push_back(const T& record) {
+			if (chunks.empty() || chunks.back().size() == CHUNK_SIZE) {
+				chunks.push_back(vector<T>());
+				chunks.back().reserve(CHUNK_SIZE); // the chunk never grows beyond this, so the records never move
+			}
+			chunks.back().push_back(record);
+			removed.push_back(false);
+		};
+		iterator erase(iterator record) {
+			removed[record.get_index()] = true;
+			removed_count++;
+			return ++record;
+		};
+		// sorting moves the records, so this must not be used once records are referenced by pointers
+		void sort() {
+			vector<T> records;
+			records.reserve(size());
+			for (iterator record = begin(); record != end(); ++record)
+				records.push_back(move(*record));
+			stable_sort(records.begin(), records.end());
+			clear();
+			for (typename vector<T>::iterator record = records.begin(); record != records.end(); ++record)
+				push_back(move(*record));
+		};
+		void clear() {
+			chunks.clear();
+			removed.clear();
+			removed_count = 0;
+		};
+};
 template <class T> class contig_annotation_index_t: public map< position_t, annotation_set_t<T> > {};
 template <class T> class annotation_index_t: public vector< contig_annotation_index_t<T> > {};
 
@@ -154,6 +336,59 @@ struct gene_annotation_record_t: public annotation_record_t {
 };
 typedef gene_annotation_record_t* gene_t;
 typedef annotation_set_t<gene_t> gene_set_t;
+// gene sets of alignments are interned, because most reads share one of a few thousand distinct gene sets
+// => alignments only store the ID of their gene set in a global table (which is not thread-safe)
+class gene_set_table_t {
+	private:
+		struct gene_set_hash_t {
+			size_t operator()(const gene_set_t& gene_set) const {
+				size_t hash = gene_set.size();
+				for (gene_set_t::const_iterator gene = gene_set.begin(); gene != gene_set.end(); ++gene)
+					hash = hash * 31 + std::hash<gene_t>()(*gene);
+				return hash;
+			};
+		};
+		unordered_map<gene_set_t,unsigned int,gene_set_hash_t> ids;
+		deque<const gene_set_t*> gene_sets; // points to the keys of <ids>, which never move
+		unordered_map<uint64_t,unsigned int> combinations[2]; // memoized results of combining two gene sets (by intersection [0] or by intersection or union [1])
+	public:
+		gene_set_table_t() { intern(gene_set_t()); }; // ID 0 is the empty set
+		unsigned int intern(const gene_set_t& gene_set) {
+			pair<unordered_map<gene_set_t,unsigned int,gene_set_hash_t>::iterator,bool> id = ids.insert(make_pair(gene_set, gene_sets.size()));
+			if (id.second)
+				gene_sets.push_back(&id.first->first);
+			return id.first->second;
+		};
+		const gene_set_t& operator[](const unsigned int id) const { return *gene_sets[id]; };
+		bool find_combination(const unsigned int id1, const unsigned int id2, const bool make_union, unsigned int& combined_id) const {
+			unordered_map<uint64_t,unsigned int>::const_iterator combination = combinations[make_union].find(((uint64_t) id1 << 32) | id2);
+			if (combination == combinations[make_union].end())
+				return false;
+			combined_id = combination->second;
+			return true;
+		};
+		void add_combination(const unsigned int id1, const unsigned int id2, const bool make_union, const unsigned int combined_id) {
+			combinations[make_union][((uint64_t) id1 << 32) | id2] = combined_id;
+		};
+};
+inline gene_set_table_t& get_gene_set_table() {
+	static gene_set_table_t gene_set_table;
+	return gene_set_table;
+}
+class interned_gene_set_t {
+	private:
+		unsigned int id;
+	public:
+		interned_gene_set_t(): id(0) {};
+		interned_gene_set_t(const gene_set_t& gene_set): id(get_gene_set_table().intern(gene_set)) {};
+		explicit interned_gene_set_t(const unsigned int id): id(id) {};
+		unsigned int get_id() const { return id; };
+		operator const gene_set_t&() const { return get_gene_set_table()[id]; };
+		bool empty() const { return id == 0; };
+		size_t size() const { return get_gene_set_table()[id].size(); };
+		gene_set_t::const_iterator begin() const { return get_gene_set_table()[id].begin(); };
+		gene_set_t::const_iterator end() const { return get_gene_set_table()[id].end(); };
+};
 typedef annotation_t<gene_annotation_record_t> gene_annotation_t;
 typedef contig_annotation_index_t<gene_t> gene_contig_annotation_index_t;
 typedef annotation_index_t<gene_t> gene_annotation_index_t;
@@ -180,10 +415,114 @@ typedef annotation_t<exon_annotation_record_t> exon_annotation_t;
 typedef contig_annotation_index_t<exon_t> exon_contig_annotation_index_t;
 typedef annotation_index_t<exon_t> exon_annotation_index_t;
 
-class cigar_t: public vector<uint32_t> {
+// CIGAR string with inline storage for a few operations, since most alignments have no more than that
+// (e.g., 10S90M or 40M500N60M); only longer CIGAR strings are allocated on the heap
+class cigar_t {
+	private:
+		static const unsigned int INLINE_CAPACITY = 4;
+		unsigned int count;
+		union {
+			uint32_t inline_operations[INLINE_CAPACITY];
+			uint32_t* heap_operations;
+		};
+		static unsigned int capacity(const unsigned int count) { // heap capacity grows in powers of two
+			unsigned int result = INLINE_CAPACITY;
+			while (result < count)
+				result *= 2;
+			return result;
+		};
+		uint32_t* operations() { return (count <= INLINE_CAPACITY) ? inline_operations : heap_operations; };
+		const uint32_t* operations() const { return (count <= INLINE_CAPACITY) ? inline_operations : heap_operations; };
 	public:
-		uint32_t operation(unsigned int index) const { return bam_cigar_op(this->at(index)); };
-		uint32_t op_length(unsigned int index) const { return bam_cigar_oplen(this->at(index)); };
+		cigar_t(): count(0) {};
+		cigar_t(const cigar_t& other): count(0) { *this = other; };
+		cigar_t(cigar_t&& other) noexcept: count(0) { *this = move(other); };
+		~cigar_t() { clear(); };
+		cigar_t& operator=(const cigar_t& other) {
+			if (this != &other) {
+				resize(other.count);
+				memcpy(operations(), other.operations(), count * sizeof(uint32_t));
+			}
+			return *this;
+		};
+		cigar_t& operator=(cigar_t&& other) noexcept {
+			if (this != &other) {
+				clear();
+				if (other.count <= INLINE_CAPACITY)
+					memcpy(inline_operations, other.inline_operations, other.count * sizeof(uint32_t));
+				else
+					heap_operations = other.heap_operations; // take over the heap buffer
+				count = other.count;
+				other.count = 0;
+			}
+			return *this;
+		};
+		void resize(const unsigned int new_count) {
+			if (capacity(new_count) != capacity(count)) { // move operations to a buffer of different size
+				uint32_t buffer[INLINE_CAPACITY];
+				uint32_t* new_operations = (new_count <= INLINE_CAPACITY) ? buffer : new uint32_t[capacity(new_count)];
+				memcpy(new_operations, operations(), min(count, new_count) * sizeof(uint32_t));
+				if (count > INLINE_CAPACITY)
+					delete[] heap_operations;
+				if (new_count <= INLINE_CAPACITY)
+					memcpy(inline_operations, buffer, new_count * sizeof(uint32_t));
+				else
+					heap_operations = new_operations;
+			}
+			unsigned int old_count = count;
+			count = new_count;
+			for (unsigned int i = old_count; i < new_count; ++i)
+				operations()[i] = 0;
+		};
+		void push_back(const uint32_t operation) { resize(count + 1); operations()[count - 1] = operation; };
+		void clear() { resize(0); };
+		size_t heap_size() const { return (count > INLINE_CAPACITY) ? capacity(count) * sizeof(uint32_t) : 0; };
+		unsigned int size() const { return count; };
+		bool empty() const { return count == 0; };
+		uint32_t& operator[](const unsigned int index) { return operations()[index]; };
+		uint32_t operator[](const unsigned int index) const { return operations()[index]; };
+		uint32_t operation(unsigned int index) const { return bam_cigar_op(operations()[index]); };
+		uint32_t op_length(unsigned int index) const { return bam_cigar_oplen(operations()[index]); };
+};
+
+// read sequence packed into 4 bits per base using the same encoding as BAM files (=ACMGRSVTWYHKDBN),
+// i.e., N's and other ambiguous bases are retained without the need for a separate mask
+class sequence_t {
+	private:
+		vector<uint8_t> packed_bases;
+		unsigned int bases;
+	public:
+		sequence_t(): bases(0) {};
+		// copy the sequence of a BAM record, which is packed the same way
+		void assign(const uint8_t* bam_sequence, const unsigned int length) {
+			packed_bases.assign(bam_sequence, bam_sequence + (length + 1) / 2);
+			bases = length;
+		};
+		void clear() { packed_bases.clear(); packed_bases.shrink_to_fit(); bases = 0; };
+		size_t heap_size() const { return packed_bases.capacity(); };
+		unsigned int size() const { return bases; };
+		unsigned int length() const { return bases; };
+		bool empty() const { return bases == 0; };
+		char operator[](const unsigned int position) const { return seq_nt16_str[(packed_bases[position/2] >> ((~position & 1) << 2)) & 0xf]; };
+		string substr(const unsigned int position = 0, const unsigned int count = UINT_MAX) const {
+			string result((position < bases) ? min(count, bases - position) : 0, 'N');
+			for (unsigned int i = 0; i < result.size(); ++i)
+				result[i] = (*this)[position + i];
+			return result;
+		};
+		// reverse complement without unpacking the bases, only A, C, G and T are complemented like in dna_to_complement()
+		sequence_t reverse_complement() const {
+			static const uint8_t complement[16] = { 0, 8, 4, 3, 2, 5, 6, 7, 1, 9, 10, 11, 12, 13, 14, 15 };
+			sequence_t result;
+			result.packed_bases.assign(packed_bases.size(), 0);
+			result.bases = bases;
+			for (unsigned int i = 0; i < bases; ++i) {
+				unsigned int j = bases - 1 - i;
+				result.packed_bases[j/2] |= complement[(packed_bases[i/2] >> ((~i & 1) << 2)) & 0xf] << ((~j & 1) << 2);
+			}
+			return result;
+		};
+		explicit operator string() const { return substr(); }; // explicit, so that the bases are not unpacked inadvertently
 };
 
 struct alignment_t {
@@ -197,8 +536,8 @@ struct alignment_t {
 	position_t start;
 	position_t end;
 	cigar_t cigar;
-	string sequence;
-	gene_set_t genes;
+	sequence_t sequence;
+	interned_gene_set_t genes;
 	alignment_t(): supplementary(false), first_in_pair(false), exonic(false), predicted_strand_ambiguous(true) {};
 	unsigned int preclipping() const { return (cigar.operation(0) == BAM_CSOFT_CLIP || cigar.operation(0) == BAM_CHARD_CLIP) ? cigar.op_length(0) : 0; };
 	unsigned int postclipping() const { return (cigar.operation(cigar.size()-1) == BAM_CSOFT_CLIP || cigar.operation(cigar.size()-1) == BAM_CHARD_CLIP) ? cigar.op_length(cigar.size()-1) : 0; };
@@ -215,9 +554,139 @@ class mates_t: public vector<alignment_t> {
 		filter_t filter; // ID of the filter which discarded the reads
 		mates_t(): single_end(false), multimapper(false), duplicate(false), filter(FILTER_none) {};
 };
-typedef map<string,mates_t> chimeric_alignments_t; // this must be an ordered map, because finding multi-mapping reads requires reads to be grouped by name
-// convenience function to undo appending of the HI tag separated by a comma to distinguish multi-mapping reads
-inline string strip_hi_tag_from_read_name(const string& read_name) { return read_name.substr(0, read_name.find_last_of(',')); };
+// the read name and the HI tag identify the alignments of a read
+// names stored in chimeric_alignments_t are interned, i.e., all alignments of a read point to the same name
+struct read_name_t {
+	const char* name;
+	int hit_index; // HI tag to distinguish multi-mapping reads
+	read_name_t(const char* name = "", const int hit_index = 1): name(name), hit_index(hit_index) {};
+};
+struct read_name_less_t {
+	bool operator()(const read_name_t& x, const read_name_t& y) const {
+		if (x.name != y.name) { // interned names are equal if the pointers are equal
+			int comparison = strcmp(x.name, y.name);
+			if (comparison != 0)
+				return comparison < 0;
+		}
+		return x.hit_index < y.hit_index;
+	};
+};
+const size_t READ_NAME_BUFFER_SIZE = 65536;
+// chimeric reads are stored contiguously and addressed by 32-bit indices:
+// - while reads are being loaded, new reads are appended and found again via a hash table of indices
+// - sort() orders the reads by name and HI tag, because finding multi-mapping reads requires reads to be grouped by name
+class chimeric_alignments_t {
+	public:
+		typedef pair<read_name_t,mates_t> value_type;
+		typedef vector<value_type>::iterator iterator;
+		typedef vector<value_type>::const_iterator const_iterator;
+	private:
+		static const uint32_t EMPTY_SLOT = UINT_MAX;
+		vector<value_type> reads;
+		vector<uint32_t> index; // hash table (with linear probing) of positions in <reads>, it is rebuilt on demand when empty
+		unsigned int index_bits;
+		list< vector<char> > read_names; // storage of interned read names (buffers never grow beyond their reserved capacity, so the names never move)
+		size_t get_slot(const char* name) const {
+			uint64_t hash = 14695981039346656037ULL; // FNV-1a
+			for (; *name != '\0'; ++name) {
+				hash ^= (unsigned char) *name;
+				hash *= 1099511628211ULL;
+			}
+			return (hash * 11400714819323198485ULL) >> (64 - index_bits); // Fibonacci hashing, so the slot does not correlate with the shard of the read
+		};
+		// returns the slot of the given read or the empty slot where it belongs
+		// if another alignment of the same read exists, <interned_name> is set to its name
+		size_t find_slot(const read_name_t& read_name, const char*& interned_name) const {
+			for (size_t slot = get_slot(read_name.name); ; slot = (slot + 1) & (index.size() - 1)) {
+				if (index[slot] == EMPTY_SLOT)
+					return slot;
+				const read_name_t& existing_read_name = reads[index[slot]].first;
+				if (existing_read_name.name == read_name.name || strcmp(existing_read_name.name, read_name.name) == 0) {
+					interned_name = existing_read_name.name;
+					if (existing_read_name.hit_index == read_name.hit_index)
+						return slot;
+				}
+			}
+		};
+		// make sure the hash table is at most half full after adding another read
+		void update_index() {
+			if (index.size() >= 2 * (reads.size() + 1))
+				return;
+			for (index_bits = 10; (1UL << index_bits) < 2 * (reads.size() + 1); ++index_bits);
+			index.assign(1UL << index_bits, (uint32_t) EMPTY_SLOT);
+			for (uint32_t read = 0; read < reads.size(); ++read) {
+				const char* interned_name;
+				index[find_slot(reads[read].first, interned_name)] = read;
+			}
+		};
+		static bool read_name_less(const value_type& x, const value_type& y) { return read_name_less_t()(x.first, y.first); };
+	public:
+		chimeric_alignments_t(): index_bits(0) {};
+		size_t size() const { return reads.size(); };
+		bool empty() const { return reads.empty(); };
+		iterator begin() { return reads.begin(); };
+		iterator end() { return reads.end(); };
+		const_iterator begin() const { return reads.begin(); };
+		const_iterator end() const { return reads.end(); };
+		// add an empty entry, unless the read exists already (the returned iterator is valid until the next entry is added)
+		// the name is copied, unless there is another alignment of the same read whose name can be reused
+		pair<iterator,bool> insert(const read_name_t& read_name) {
+			update_index();
+			const char* name = NULL;
+			size_t slot = find_slot(read_name, name);
+			if (index[slot] != EMPTY_SLOT)
+				return make_pair(reads.begin() + index[slot], false);
+			if (name == NULL) { // first alignment of this read => intern name
+				size_t length = strlen(read_name.name) + 1;
+				if (read_names.empty() || read_names.back().capacity() - read_names.back().size() < length) {
+					read_names.push_back(vector<char>());
+					read_names.back().reserve(max(length, READ_NAME_BUFFER_SIZE));
+				}
+				name = read_names.back().data() + read_names.back().size();
+				read_names.back().insert(read_names.back().end(), read_name.name, read_name.name + length);
+			}
+			index[slot] = reads.size();
+			reads.push_back(value_type(read_name_t(name, read_name.hit_index), mates_t()));
+			return make_pair(prev(reads.end()), true);
+		};
+		mates_t& operator[](const read_name_t& read_name) { return insert(read_name).first->second; };
+		iterator find(const read_name_t& read_name) {
+			update_index();
+			const char* interned_name;
+			size_t slot = find_slot(read_name, interned_name);
+			return (index[slot] == EMPTY_SLOT) ? reads.end() : reads.begin() + index[slot];
+		};
+		iterator erase(iterator first, iterator last) {
+			index.clear();
+			return reads.erase(first, last);
+		};
+		// group the reads by name, the hash table is no longer needed thereafter
+		void sort() {
+			if (!is_sorted(reads.begin(), reads.end(), read_name_less))
+				std::sort(reads.begin(), reads.end(), read_name_less);
+			vector<uint32_t>().swap(index);
+		};
+		// move all entries of <other> to this object, the reads of both objects must be disjoint
+		void merge(chimeric_alignments_t& other) {
+			reads.reserve(reads.size() + other.reads.size());
+			for (iterator chimeric_alignment = other.begin(); chimeric_alignment != other.end(); ++chimeric_alignment)
+				reads.push_back(move(*chimeric_alignment));
+			read_names.splice(read_names.end(), other.read_names);
+			index.clear();
+			other.clear();
+		};
+		void swap(chimeric_alignments_t& other) {
+			reads.swap(other.reads);
+			index.swap(other.index);
+			std::swap(index_bits, other.index_bits);
+			read_names.swap(other.read_names);
+		};
+		void clear() {
+			reads.clear();
+			index.clear();
+			read_names.clear();
+		};
+};
 
 typedef unsigned char confidence_t;
 const confidence_t CONFIDENCE_LOW = 0;
@@ -251,9 +720,10 @@ struct fusion_t {
 	position_t breakpoint1, breakpoint2;
 	position_t anchor_start1, anchor_start2;
 	position_t closest_genomic_breakpoint1, closest_genomic_breakpoint2;
+	unsigned int subsampled_split_reads1, subsampled_split_reads2; // non-discarded split reads beyond the subsampling threshold (counted, but not retained in the lists)
 	gene_t gene1, gene2;
 	vector<chimeric_alignments_t::iterator> split_read1_list, split_read2_list, discordant_mate_list;
-	fusion_t(): transcript_start_ambiguous(true), split_reads1(0), transcript_start(TRANSCRIPT_START_GENE1), split_reads2(0), spliced1(false), spliced2(false), exonic1(false), exonic2(false), predicted_strand1(FORWARD), predicted_strand2(FORWARD), direction1(DOWNSTREAM), direction2(DOWNSTREAM), confidence(CONFIDENCE_LOW), filter(FILTER_none), predicted_strands_ambiguous(true), discordant_mates(0), contig1(USHRT_MAX), contig2(USHRT_MAX), evalue(0), breakpoint1(-1), breakpoint2(-1), anchor_start1(0), anchor_start2(0), closest_genomic_breakpoint1(-1), closest_genomic_breakpoint2(-1), gene1(NULL), gene2(NULL) {};
+	fusion_t(): transcript_start_ambiguous(true), split_reads1(0), transcript_start(TRANSCRIPT_START_GENE1), split_reads2(0), spliced1(false), spliced2(false), exonic1(false), exonic2(false), predicted_strand1(FORWARD), predicted_strand2(FORWARD), direction1(DOWNSTREAM), direction2(DOWNSTREAM), confidence(CONFIDENCE_LOW), filter(FILTER_none), predicted_strands_ambiguous(true), discordant_mates(0), contig1(USHRT_MAX), contig2(USHRT_MAX), evalue(0), breakpoint1(-1), breakpoint2(-1), anchor_start1(0), anchor_start2(0), closest_genomic_breakpoint1(-1), closest_genomic_breakpoint2(-1), subsampled_split_reads1(0), subsampled_split_reads2(0), gene1(NULL), gene2(NULL) {};
 	unsigned int supporting_reads() const { return split_reads1 + split_reads2 + discordant_mates; };
 	bool breakpoint_overlaps_both_genes(const unsigned int which_breakpoint = 0) const {
 		if (which_breakpoint == 1) return breakpoint1 >= gene2->start && breakpoint1 <= gene2->end;
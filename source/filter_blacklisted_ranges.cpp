@@ -257,6 +257,10 @@ unsigned int filter_blacklisted_ranges(fusions_t& fusions, const string& blackli
 		tsv_stream_t tsv(line);
 		string range1, range2;
 		tsv >> range1 >> range2;
+		if (tsv.fail()) {
+			cerr << "WARNING: failed to parse line in blacklist: " << line << endl;
+			continue;
+		}
 		blacklist_item_t item1, item2;
 		if (!parse_blacklist_item(range1, item1, contigs, genes, false) ||
 		    !parse_blacklist_item(range2, item2, contigs, genes, true))
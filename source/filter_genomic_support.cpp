@@ -104,7 +104,8 @@ unsigned int mark_genomic_support(fusions_t& fusions, const string& genomic_brea
 
 				// parsing as Arriba's four-column format failed => try VCF
 				tsv_stream_t tsv2(line);
-				string vcf_chrom, vcf_pos, vcf_alt, vcf_info, vcf_filter, ignore;
+				string vcf_chrom, vcf_pos, vcf_alt, vcf_info, vcf_filter;
+				string_view_t ignore;
 				tsv2 >> vcf_chrom >> vcf_pos >> ignore >> ignore >> vcf_alt >> ignore >> vcf_filter >> vcf_info;
 				if (!parse_vcf_info(vcf_info, "SVTYPE", vcf_sv_type))
 					goto failed_to_parse_line;
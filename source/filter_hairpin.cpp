@@ -35,7 +35,7 @@ unsigned int filter_hairpin(chimeric_alignments_t& chimeric_alignments, exon_ann
 			continue; // the read has already been filtered
 
 		// check if mate1 and mate2 map to the same gene or close to one another
-		gene_set_t common_genes;
+		interned_gene_set_t common_genes;
 		if (chimeric_alignment->second.size() == 2) { // discordant mate
 			combine_annotations(chimeric_alignment->second[MATE1].genes, chimeric_alignment->second[MATE2].genes, common_genes, false);
 			if (common_genes.empty() && chimeric_alignment->second[MATE1].contig != chimeric_alignment->second[MATE2].contig) {
@@ -37,6 +37,8 @@ bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& km
 		small_gene_sequence = dna_to_reverse_complement(small_gene_sequence);
 
 	// count how many k-mers of the small gene can be found in the big gene
+	contig_sequence_t big_gene_contig_sequence = assembly.at(big_gene->contig);
+	string extended_kmer;
 	unsigned int matching_kmers = 0;
 	for (string::size_type pos = 0; pos + 2*kmer_length < small_gene_sequence.size(); pos += kmer_length) {
 
@@ -47,7 +49,8 @@ bool is_homolog(const gene_t gene1, const gene_t gene2, const kmer_indices_t& km
 		if (kmer_hits != kmer_indices[big_gene->contig].end()) {
 			for (auto kmer_hit = lower_bound(kmer_hits->second.begin(), kmer_hits->second.end(), big_gene->start); kmer_hit != kmer_hits->second.end() && *kmer_hit <= big_gene->end; ++kmer_hit) {
 				if (small_gene->contig != big_gene->contig || *kmer_hit < small_gene->start || *kmer_hit > small_gene->end) {
-					if (strncmp(assembly.at(big_gene->contig).c_str()+*kmer_hit+kmer_length, small_gene_sequence.c_str()+pos+kmer_length, extended_kmer_length) == 0) {
+					big_gene_contig_sequence.copy(*kmer_hit+kmer_length, extended_kmer_length, extended_kmer);
+					if (small_gene_sequence.compare(pos+kmer_length, extended_kmer_length, extended_kmer) == 0) {
 						matching_kmers++;
 						if (matching_kmers * kmer_length >= small_gene->length() * max_identity_fraction)
 							return true;
@@ -13,18 +13,18 @@ unsigned int filter_low_coverage_viral_contigs(chimeric_alignments_t& chimeric_a
 	// compute average coverage for each viral contig
 	vector<float> average_coverage(viral_contigs.size());
 	for (contig_t contig = 0; contig < viral_contigs.size(); ++contig) {
-		for (auto window = coverage.coverage[contig].begin(); window != coverage.coverage[contig].end(); ++window)
-			average_coverage[contig] += *window;
-		average_coverage[contig] /= coverage.coverage[contig].size();
+		for (unsigned int window = 0; window < coverage.get_windows(contig); ++window)
+			average_coverage[contig] += coverage.get_window_coverage(contig, window);
+		average_coverage[contig] /= coverage.get_windows(contig);
 	}
 
 	// for each viral contig, determine fraction that is covered at least as highly as 0.05 * average coverage
 	vector<float> fraction_with_sufficient_coverage(viral_contigs.size());
 	for (contig_t contig = 0; contig < viral_contigs.size(); ++contig) {
-		for (auto window = coverage.coverage[contig].begin(); window != coverage.coverage[contig].end(); ++window)
-			if (*window > 0.05 * average_coverage[contig])
+		for (unsigned int window = 0; window < coverage.get_windows(contig); ++window)
+			if (coverage.get_window_coverage(contig, window) > 0.05 * average_coverage[contig])
 				fraction_with_sufficient_coverage[contig]++;
-		fraction_with_sufficient_coverage[contig] /= coverage.coverage[contig].size();
+		fraction_with_sufficient_coverage[contig] /= coverage.get_windows(contig);
 	}
 
 	unsigned int remaining = 0;
@@ -57,9 +57,10 @@ unsigned int filter_low_entropy(chimeric_alignments_t& chimeric_alignments, cons
 				vector<string::size_type> previous_kmer_pos(kmer_count.size());
 
 				// count all different k-mers for each read
-				for (string::size_type kmer_pos = 0; kmer_pos < chimeric_alignment->second[mate].sequence.length() - kmer_length; kmer_pos++) {
+				string sequence = chimeric_alignment->second[mate].sequence.substr(); // unpack sequence once for k-mer extraction
+				for (string::size_type kmer_pos = 0; kmer_pos < sequence.length() - kmer_length; kmer_pos++) {
 
-					kmer_as_int_t kmer_as_int = kmer_to_int(chimeric_alignment->second[mate].sequence, kmer_pos, kmer_length);
+					kmer_as_int_t kmer_as_int = kmer_to_int(sequence, kmer_pos, kmer_length);
 
 					// only count the k-mer if it does not overlap with a k-mer with identical sequence
 					if (previous_kmer_pos[kmer_as_int] <= kmer_pos) {
@@ -63,14 +63,14 @@ void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, int p
 
 	// store positions of kmers in hash
 	for (gene_set_t::iterator gene = genes_to_filter.begin(); gene != genes_to_filter.end(); ++gene) {
-		const string& contig_sequence = assembly.at((**gene).contig);
 		if ((int) kmer_indices.size() <= (**gene).contig)
 			kmer_indices.resize((**gene).contig+1);
 		position_t gene_start = max((**gene).start - padding, 0);
 		position_t gene_end = min((**gene).end + padding, (int) assembly.at((**gene).contig).size() - 1);
+		string gene_sequence = assembly.at((**gene).contig).substr(gene_start, gene_end - gene_start + 1);
 		for (position_t pos = gene_start; pos + kmer_length < gene_end; pos++)
-			if (contig_sequence[pos] != 'N') // don't index masked regions, as long stretches of N's inflate the number of hits
-				kmer_indices[(**gene).contig][kmer_to_int(contig_sequence, pos, kmer_length)].push_back(pos);
+			if (gene_sequence[pos - gene_start] != 'N') // don't index masked regions, as long stretches of N's inflate the number of hits
+				kmer_indices[(**gene).contig][kmer_to_int(gene_sequence, pos - gene_start, kmer_length)].push_back(pos);
 	}
 
 	// sort kmer hits by increasing position, so that we can go through the list sequentially
@@ -83,7 +83,7 @@ void make_kmer_index(const fusions_t& fusions, const assembly_t& assembly, int p
 		}
 }
 
-bool align(int score, const string& read_sequence, int read_pos, const string& contig_sequence, const int gene_pos, const position_t gene_start, const position_t gene_end, const kmer_index_t& kmer_index, const char kmer_length, const splice_sites_t& splice_sites, const int min_score, int max_deletions) {
+bool align(int score, const string& read_sequence, int read_pos, const contig_sequence_t& contig_sequence, const int gene_pos, const position_t gene_start, const position_t gene_end, const kmer_index_t& kmer_index, const char kmer_length, const splice_sites_t& splice_sites, const int min_score, int max_deletions) {
 
 	int skipped_bases = 0;
 
@@ -186,10 +186,10 @@ bool align(int score, const string& read_sequence, int read_pos, const string& c
 	return false;
 }
 
-bool align_both_strands(const string& read_sequence, const int read_length, const int max_mate_gap, const bool breakpoints_on_same_contig, const position_t alignment_start, const position_t alignment_end, const kmer_indices_t& kmer_indices, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, splice_sites_by_gene_t& splice_sites_by_gene, gene_set_t& genes, const char kmer_length, const float min_align_percent) {
+bool align_both_strands(const string& read_sequence, const int read_length, const int max_mate_gap, const bool breakpoints_on_same_contig, const position_t alignment_start, const position_t alignment_end, const kmer_indices_t& kmer_indices, const assembly_t& assembly, const exon_annotation_index_t& exon_annotation_index, splice_sites_by_gene_t& splice_sites_by_gene, const gene_set_t& genes, const char kmer_length, const float min_align_percent) {
 
 	int min_score = min_align_percent * read_sequence.size() + 0.5;
-	for (gene_set_t::iterator gene = genes.begin(); gene != genes.end(); ++gene) {
+	for (gene_set_t::const_iterator gene = genes.begin(); gene != genes.end(); ++gene) {
 
 		// find all splice sites in the genes
 		if (splice_sites_by_gene.find(*gene) == splice_sites_by_gene.end())
@@ -319,8 +319,8 @@ unsigned int filter_mismappers(fusions_t& fusions, const kmer_indices_t& kmer_in
 			float clipped_fraction1 = ((float) mate1.preclipping() + mate1.postclipping()) / mate1.sequence.size();
 			float clipped_fraction2 = ((float) mate2.preclipping() + mate2.postclipping()) / mate2.sequence.size();
 
-			if (align_both_strands(mate1.sequence, mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate2.genes, kmer_length, min(min_align_percent, min_align_percent*(1-clipped_fraction1))) ||
-			    align_both_strands(mate2.sequence, mate2.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate2.start, mate2.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate1.genes, kmer_length, min(min_align_percent, min_align_percent*(1-clipped_fraction2)))) {
+			if (align_both_strands(mate1.sequence.substr(), mate1.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate1.start, mate1.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate2.genes, kmer_length, min(min_align_percent, min_align_percent*(1-clipped_fraction1))) ||
+			    align_both_strands(mate2.sequence.substr(), mate2.sequence.size(), max_mate_gap, fusion->second.contig1 == fusion->second.contig2, mate2.start, mate2.end, kmer_indices, assembly, exon_annotation_index, splice_sites_by_gene, mate1.genes, kmer_length, min(min_align_percent, min_align_percent*(1-clipped_fraction2)))) {
 				(**chimeric_alignment).second.filter = FILTER_mismappers;
 			}
 		}
@@ -14,9 +14,9 @@ bool is_gap_at_splice_site(const position_t position, const direction_t directio
 	return false;
 }
 
-int calculate_segment_score(const alignment_t& alignment, const string& sequence, const exon_annotation_index_t& exon_annotation_index, const assembly_t& assembly) {
+int calculate_segment_score(const alignment_t& alignment, const sequence_t& sequence, const exon_annotation_index_t& exon_annotation_index, const assembly_t& assembly) {
 
-	if (assembly.find(alignment.contig) == assembly.end())
+	if (!assembly.count(alignment.contig))
 		return 0;
 
 	int score = 0;
@@ -68,7 +68,10 @@ int calculate_alignment_score(const mates_t& mates, const exon_annotation_index_
 	            calculate_segment_score(mates[MATE2], mates[MATE2].sequence, exon_annotation_index, assembly);
 
 	if (mates.size() == 3) { // has a supplementary alignment
-		score += calculate_segment_score(mates[SUPPLEMENTARY], (mates[SUPPLEMENTARY].strand == mates[SPLIT_READ].strand) ? mates[SPLIT_READ].sequence : dna_to_reverse_complement(mates[SPLIT_READ].sequence), exon_annotation_index, assembly);
+		if (mates[SUPPLEMENTARY].strand == mates[SPLIT_READ].strand)
+			score += calculate_segment_score(mates[SUPPLEMENTARY], mates[SPLIT_READ].sequence, exon_annotation_index, assembly);
+		else
+			score += calculate_segment_score(mates[SUPPLEMENTARY], mates[SPLIT_READ].sequence.reverse_complement(), exon_annotation_index, assembly);
 		// penalize if the read is not split at a splice site
 		if (!is_gap_at_splice_site((mates[SUPPLEMENTARY].strand == FORWARD) ? mates[SUPPLEMENTARY].end : mates[SUPPLEMENTARY].start, (mates[SUPPLEMENTARY].strand == FORWARD) ? DOWNSTREAM : UPSTREAM, mates[SUPPLEMENTARY].genes, exon_annotation_index) ||
 		    !is_gap_at_splice_site((mates[SPLIT_READ].strand == FORWARD) ? mates[SPLIT_READ].start : mates[SPLIT_READ].end, (mates[SPLIT_READ].strand == FORWARD) ? UPSTREAM : DOWNSTREAM, mates[SPLIT_READ].genes, exon_annotation_index))
@@ -139,9 +142,9 @@ unsigned int filter_multimappers(chimeric_alignments_t& chimeric_alignments, fus
 
 	// for each group of multi-mapping alignments, pick the one with the highest alignment score
 	chimeric_alignments_t::iterator start_of_cluster = chimeric_alignments.begin();
-	string read_name = (!chimeric_alignments.empty()) ? strip_hi_tag_from_read_name(start_of_cluster->first) : "";
-	string next_read_name = read_name;
-	string cluster_name = read_name;
+	const char* read_name = (!chimeric_alignments.empty()) ? start_of_cluster->first.name : NULL; // names are interned, so it suffices to compare pointers
+	const char* next_read_name = read_name;
+	const char* cluster_name = read_name;
 	mates_t* best_alignment = NULL;
 	int best_alignment_score = INT_MIN;
 	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); ; ++chimeric_alignment) {
@@ -170,7 +173,7 @@ unsigned int filter_multimappers(chimeric_alignments_t& chimeric_alignments, fus
 
 		// peek into the next read
 		// we can skip the calculation of alignment score, if it is a uniquely mapping read
-		next_read_name = (next(chimeric_alignment) != chimeric_alignments.end()) ? strip_hi_tag_from_read_name(next(chimeric_alignment)->first) : "";
+		next_read_name = (next(chimeric_alignment) != chimeric_alignments.end()) ? next(chimeric_alignment)->first.name : NULL;
 		if (start_of_cluster == chimeric_alignment && next_read_name != read_name)
 			continue;
 
@@ -12,7 +12,7 @@ unsigned int filter_same_gene(chimeric_alignments_t& chimeric_alignments, exon_a
 			continue; // the read has already been filtered
 
 		// check if mate1 and mate2 map to the same gene
-		gene_set_t common_genes;
+		interned_gene_set_t common_genes;
 		if (chimeric_alignment->second.size() == 2) // discordant mate
 			combine_annotations(chimeric_alignment->second[MATE1].genes, chimeric_alignment->second[MATE2].genes, common_genes, false);
 		else // split read
@@ -24,8 +24,8 @@ unsigned int filter_top_expressed_viral_contigs(chimeric_alignments_t& chimeric_
 	vector<float> expression_by_contig;
 	expression_by_contig.reserve(mapped_viral_reads_by_contig.size());
 	for (size_t contig = 0; contig < mapped_viral_reads_by_contig.size(); ++contig)
-		if (assembly.find(contig) != assembly.end())
-			expression_by_contig.push_back(1.0 * mapped_viral_reads_by_contig.at(contig)/assembly.at(contig).size());
+		if (assembly.count(contig))
+			expression_by_contig.push_back(1.0 * mapped_viral_reads_by_contig.at(contig)/assembly.length(contig));
 		else
 			expression_by_contig.push_back(0);
 
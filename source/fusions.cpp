@@ -200,20 +200,84 @@ void predict_transcript_start(fusion_t& fusion) {
 }
 
 
+// once a fusion has reached the subsampling threshold, further non-discarded split reads replace
+// a random one of the retained ones (reservoir sampling), such that the retained reads are a uniform sample
+// and not biased towards the reads which come first in the order of read names
+// the reads beyond the threshold are counted in <subsampled_reads>, so that the total number of split reads is exact
+// this total is only reported in the output, the filters see the counts of the retained reads
+// sampling cannot happen while reads are loaded, because a split read is only complete once all its records
+// have been read and because the marking of duplicates and multi-mapping reads needs every read
+// => subsampling saves runtime in later steps, but does not reduce the memory needed to hold the reads
+enum sampled_read_t { READ_SKIPPED, READ_ADDED, READ_REPLACED };
+sampled_read_t subsample_split_read(vector<chimeric_alignments_t::iterator>& read_list, const chimeric_alignments_t::iterator& read, const unsigned int counted_reads, const unsigned int subsampling_threshold, unsigned int& subsampled_reads, uint64_t& random_state) {
+
+	if (counted_reads < subsampling_threshold) {
+		read_list.push_back(read);
+		return READ_ADDED;
+	}
+
+	// pick a random number in the range [0, reads seen so far) using a fixed LCG, so results are reproducible
+	unsigned long int seen_reads = (unsigned long int) subsampling_threshold + ++subsampled_reads;
+	random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	unsigned long int replaced_read = (random_state >> 33) % seen_reads;
+	if (replaced_read >= subsampling_threshold)
+		return READ_SKIPPED;
+
+	// replace the n-th non-discarded read (discarded reads are retained as they are)
+	for (auto retained_read = read_list.begin(); retained_read != read_list.end(); ++retained_read) {
+		if ((**retained_read).second.filter == FILTER_none) {
+			if (replaced_read == 0) {
+				*retained_read = read;
+				break;
+			}
+			--replaced_read;
+		}
+	}
+	return READ_REPLACED;
+}
+
+// extend the anchors of a fusion to cover the given supporting read
+void expand_anchor(fusion_t& fusion, const position_t anchor_start1, const position_t anchor_start2) {
+	if (fusion.direction1 == DOWNSTREAM && (anchor_start1 < fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
+		fusion.anchor_start1 = anchor_start1;
+	} else if (fusion.direction1 == UPSTREAM && (anchor_start1 > fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
+		fusion.anchor_start1 = anchor_start1;
+	}
+	if (fusion.direction2 == DOWNSTREAM && (anchor_start2 < fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
+		fusion.anchor_start2 = anchor_start2;
+	} else if (fusion.direction2 == UPSTREAM && (anchor_start2 > fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
+		fusion.anchor_start2 = anchor_start2;
+	}
+}
+
+// extend the anchors of a fusion to cover the split reads in the given list
+// <swapped> indicates that the supplementary alignment of the reads in the list is on the side of breakpoint1
+void expand_anchor_by_split_reads(fusion_t& fusion, const vector<chimeric_alignments_t::iterator>& split_read_list, const bool swapped) {
+	for (auto split_read = split_read_list.begin(); split_read != split_read_list.end(); ++split_read) {
+		const alignment_t& mate1 = (**split_read).second[MATE1];
+		const alignment_t& supplementary = (**split_read).second[SUPPLEMENTARY];
+		position_t anchor_start1 = (mate1.strand == FORWARD) ? mate1.start : mate1.end;
+		position_t anchor_start2 = (supplementary.strand == FORWARD) ? supplementary.start : supplementary.end;
+		if (swapped)
+			swap(anchor_start1, anchor_start2);
+		expand_anchor(fusion, anchor_start1, anchor_start2);
+	}
+}
+
 unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, const unsigned int subsampling_threshold) {
 
 	unordered_map< tuple<unsigned int/*gene1->id*/,unsigned int/*gene2->id*/,direction_t/*1*/,direction_t/*2*/>, vector< tuple<position_t/*breakpoint1*/,position_t/*breakpoint2*/,chimeric_alignments_t::iterator> > > discordant_mates_by_gene_pair; // contains the discordant mates for each pair of genes
 
 	bool subsampled_fusions = false;
+	uint64_t random_state = 0;
 
 	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
 
 		contig_t contig1, contig2;
 		position_t breakpoint1, breakpoint2;
 		direction_t direction1, direction2;
-		gene_set_t genes1, genes2;
+		interned_gene_set_t genes1, genes2;
 		bool exonic1, exonic2;
-		position_t anchor_start1, anchor_start2;
 
 		if (chimeric_alignment->second.size() == 3) { // split read
 
@@ -228,8 +292,6 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 			direction2 = (chimeric_alignment->second[SUPPLEMENTARY].strand == FORWARD) ? DOWNSTREAM : UPSTREAM;
 			exonic1 = chimeric_alignment->second[SPLIT_READ].exonic;
 			exonic2 = chimeric_alignment->second[SUPPLEMENTARY].exonic;
-			anchor_start1 = (chimeric_alignment->second[MATE1].strand == FORWARD) ? chimeric_alignment->second[MATE1].start : chimeric_alignment->second[MATE1].end;
-			anchor_start2 = (chimeric_alignment->second[SUPPLEMENTARY].strand == FORWARD) ? chimeric_alignment->second[SUPPLEMENTARY].start : chimeric_alignment->second[SUPPLEMENTARY].end;
 
 			// make sure the breakpoint with the lower coordinate is always first
 			// otherwise the same fusion could generate two entries in the fusions hashmap
@@ -240,13 +302,12 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 				swap(genes1, genes2);
 				swap(direction1, direction2);
 				swap(exonic1, exonic2);
-				swap(anchor_start1, anchor_start2);
 				swapped = true;
 			}
 
 			// make a fusion from the given breakpoints
-			for (gene_set_t::iterator gene1 = genes1.begin(); gene1 != genes1.end(); ++gene1) {
-				for (gene_set_t::iterator gene2 = genes2.begin(); gene2 != genes2.end(); ++gene2) {
+			for (gene_set_t::const_iterator gene1 = genes1.begin(); gene1 != genes1.end(); ++gene1) {
+				for (gene_set_t::const_iterator gene2 = genes2.begin(); gene2 != genes2.end(); ++gene2) {
 
 					// copy properties of supporting read to fusion
 					pair<fusions_t::iterator,bool> is_new_fusion = fusions.insert(make_pair(make_tuple((**gene1).id, (**gene2).id, contig1, contig2, breakpoint1, breakpoint2, direction1, direction2), fusion_t()));
@@ -262,40 +323,28 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 					if (is_new_fusion.second || chimeric_alignment->second.filter == FILTER_none || fusion.filter == FILTER_duplicates)
 						fusion.filter = chimeric_alignment->second.filter;
 
-					if (fusion.split_reads1 >= subsampling_threshold && !swapped ||
-					    fusion.split_reads2 >= subsampling_threshold &&  swapped ||
-					    chimeric_alignment->second.filter != FILTER_none && !swapped && fusion.split_read1_list.size() >= subsampling_threshold ||
-					    chimeric_alignment->second.filter != FILTER_none &&  swapped && fusion.split_read2_list.size() >= subsampling_threshold) {
-
-						// subsampling improves performance, especially in multiple myeloma samples
-						subsampled_fusions = true;
-
-					} else {
-
-						// expand the size of the anchor
-						if (fusion.direction1 == DOWNSTREAM && (anchor_start1 < fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
-							fusion.anchor_start1 = anchor_start1;
-						} else if (fusion.direction1 == UPSTREAM && (anchor_start1 > fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
-							fusion.anchor_start1 = anchor_start1;
-						}
-						if (fusion.direction2 == DOWNSTREAM && (anchor_start2 < fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
-							fusion.anchor_start2 = anchor_start2;
-						} else if (fusion.direction2 == UPSTREAM && (anchor_start2 > fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
-							fusion.anchor_start2 = anchor_start2;
-						}
-
-						// increase split read counters for the given fusion
-						if (swapped) {
-							fusion.split_read2_list.push_back(chimeric_alignment);
-							if (chimeric_alignment->second.filter == FILTER_none)
-								fusion.split_reads2++;
+					// subsampling improves performance, especially in multiple myeloma samples
+					sampled_read_t sampled_read;
+					if (chimeric_alignment->second.filter != FILTER_none) { // discarded reads are only kept until the threshold is reached
+						if (!swapped && (fusion.split_reads1 >= subsampling_threshold || fusion.split_read1_list.size() >= subsampling_threshold) ||
+						     swapped && (fusion.split_reads2 >= subsampling_threshold || fusion.split_read2_list.size() >= subsampling_threshold)) {
+							sampled_read = READ_SKIPPED;
 						} else {
-							fusion.split_read1_list.push_back(chimeric_alignment);
-							if (chimeric_alignment->second.filter == FILTER_none)
-								fusion.split_reads1++;
+							(swapped ? fusion.split_read2_list : fusion.split_read1_list).push_back(chimeric_alignment);
+							sampled_read = READ_ADDED;
 						}
-
+					} else if (swapped) {
+						sampled_read = subsample_split_read(fusion.split_read2_list, chimeric_alignment, fusion.split_reads2, subsampling_threshold, fusion.subsampled_split_reads2, random_state);
+						if (sampled_read == READ_ADDED)
+							fusion.split_reads2++;
+					} else {
+						sampled_read = subsample_split_read(fusion.split_read1_list, chimeric_alignment, fusion.split_reads1, subsampling_threshold, fusion.subsampled_split_reads1, random_state);
+						if (sampled_read == READ_ADDED)
+							fusion.split_reads1++;
 					}
+
+					if (sampled_read != READ_ADDED)
+						subsampled_fusions = true;
 				}
 			}
 
@@ -312,8 +361,8 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 			direction2 = (chimeric_alignment->second[MATE2].strand == FORWARD) ? DOWNSTREAM : UPSTREAM;
 			exonic1 = chimeric_alignment->second[MATE1].exonic;
 			exonic2 = chimeric_alignment->second[MATE2].exonic;
-			anchor_start1 = (chimeric_alignment->second[MATE1].strand == FORWARD) ? chimeric_alignment->second[MATE1].start : chimeric_alignment->second[MATE1].end;
-			anchor_start2 = (chimeric_alignment->second[MATE2].strand == FORWARD) ? chimeric_alignment->second[MATE2].start : chimeric_alignment->second[MATE2].end;
+			position_t anchor_start1 = (chimeric_alignment->second[MATE1].strand == FORWARD) ? chimeric_alignment->second[MATE1].start : chimeric_alignment->second[MATE1].end;
+			position_t anchor_start2 = (chimeric_alignment->second[MATE2].strand == FORWARD) ? chimeric_alignment->second[MATE2].start : chimeric_alignment->second[MATE2].end;
 
 			// make sure the breakpoint with the lower coordinate is always first
 			// otherwise the same fusion could generate two entries in the fusions hashmap
@@ -327,8 +376,8 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 			}
 
 			// make a fusion from the given breakpoints
-			for (gene_set_t::iterator gene1 = genes1.begin(); gene1 != genes1.end(); ++gene1) {
-				for (gene_set_t::iterator gene2 = genes2.begin(); gene2 != genes2.end(); ++gene2) {
+			for (gene_set_t::const_iterator gene1 = genes1.begin(); gene1 != genes1.end(); ++gene1) {
+				for (gene_set_t::const_iterator gene2 = genes2.begin(); gene2 != genes2.end(); ++gene2) {
 
 					// copy properties of supporting read to fusion
 					pair<fusions_t::iterator,bool> is_new_fusion = fusions.insert(make_pair(make_tuple((**gene1).id, (**gene2).id, contig1, contig2, breakpoint1, breakpoint2, direction1, direction2), fusion_t()));
@@ -345,16 +394,7 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 						fusion.filter = chimeric_alignment->second.filter;
 
 					// expand the size of the anchor
-					if (fusion.direction1 == DOWNSTREAM && (anchor_start1 < fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
-						fusion.anchor_start1 = anchor_start1;
-					} else if (fusion.direction1 == UPSTREAM && (anchor_start1 > fusion.anchor_start1 || fusion.anchor_start1 == 0)) {
-						fusion.anchor_start1 = anchor_start1;
-					}
-					if (fusion.direction2 == DOWNSTREAM && (anchor_start2 < fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
-						fusion.anchor_start2 = anchor_start2;
-					} else if (fusion.direction2 == UPSTREAM && (anchor_start2 > fusion.anchor_start2 || fusion.anchor_start2 == 0)) {
-						fusion.anchor_start2 = anchor_start2;
-					}
+					expand_anchor(fusion, anchor_start1, anchor_start2);
 
 					// store the discordant mates in a hashmap for fast lookup
 					// we will need this later to find all the discordant mates supporting a given fusion
@@ -364,6 +404,13 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 		}
 	}
 
+	// expand the size of the anchors by the split reads which were retained after subsampling
+	// (this must happen after subsampling, because retained reads may be replaced by reads that come later)
+	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		expand_anchor_by_split_reads(fusion->second, fusion->second.split_read1_list, false);
+		expand_anchor_by_split_reads(fusion->second, fusion->second.split_read2_list, true);
+	}
+
 	// for each fusion, count the supporting discordant mates
 	for (fusions_t::iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
 
@@ -470,3 +517,33 @@ unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t&
 	return remaining;
 }
 
+// the sequences and CIGAR strings of reads which are not part of any fusion cannot influence the output anymore
+// only their coordinates, gene sets and filters are kept, because some steps derive statistics from all reads
+// this is done in a single pass, because the alignments of reads discarded by earlier filters are still
+// needed to find discarded fusions, to score multi-mappers and to estimate the fragment length
+unsigned long int release_unused_alignments(chimeric_alignments_t& chimeric_alignments, const fusions_t& fusions) {
+
+	// mark reads which support a fusion (regardless of whether they were discarded)
+	vector<bool> supporting_reads(chimeric_alignments.size());
+	for (fusions_t::const_iterator fusion = fusions.begin(); fusion != fusions.end(); ++fusion) {
+		for (auto chimeric_alignment = fusion->second.split_read1_list.begin(); chimeric_alignment != fusion->second.split_read1_list.end(); ++chimeric_alignment)
+			supporting_reads[*chimeric_alignment - chimeric_alignments.begin()] = true;
+		for (auto chimeric_alignment = fusion->second.split_read2_list.begin(); chimeric_alignment != fusion->second.split_read2_list.end(); ++chimeric_alignment)
+			supporting_reads[*chimeric_alignment - chimeric_alignments.begin()] = true;
+		for (auto chimeric_alignment = fusion->second.discordant_mate_list.begin(); chimeric_alignment != fusion->second.discordant_mate_list.end(); ++chimeric_alignment)
+			supporting_reads[*chimeric_alignment - chimeric_alignments.begin()] = true;
+	}
+
+	unsigned long int freed_bytes = 0;
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
+		if (!supporting_reads[chimeric_alignment - chimeric_alignments.begin()]) {
+			for (mates_t::iterator mate = chimeric_alignment->second.begin(); mate != chimeric_alignment->second.end(); ++mate) {
+				freed_bytes += mate->sequence.heap_size() + mate->cigar.heap_size();
+				mate->sequence.clear();
+				mate->cigar.clear();
+			}
+		}
+	}
+
+	return freed_bytes;
+}
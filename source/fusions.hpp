@@ -8,4 +8,6 @@ using namespace std;
 
 unsigned int find_fusions(chimeric_alignments_t& chimeric_alignments, fusions_t& fusions, exon_annotation_index_t& exon_annotation_index, const int max_mate_gap, const unsigned int subsampling_threshold);
 
+unsigned long int release_unused_alignments(chimeric_alignments_t& chimeric_alignments, const fusions_t& fusions);
+
 #endif /* _FIND_FUSIONS_H */
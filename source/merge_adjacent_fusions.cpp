@@ -61,7 +61,7 @@ unsigned int merge_adjacent_fusions(fusions_t& fusions, const int max_distance)
 		}
 
 		// select the one with the most supporting alignments
-		unsigned int sum_split_reads1 = 0, sum_split_reads2 = 0;
+		unsigned int sum_split_reads1 = 0, sum_split_reads2 = 0, sum_subsampled_split_reads1 = 0, sum_subsampled_split_reads2 = 0;
 		bool fusion_has_most_support = true;
 		for (unsigned int k = 0; k < adjacent_fusions.size(); ++k) {
 			if ((**fusion).supporting_reads() < adjacent_fusions[k]->supporting_reads()) { // fewer supporting reads => this is not the best fusion
@@ -70,6 +70,8 @@ unsigned int merge_adjacent_fusions(fusions_t& fusions, const int max_distance)
 			} else {
 				sum_split_reads1 += adjacent_fusions[k]->split_reads1;
 				sum_split_reads2 += adjacent_fusions[k]->split_reads2;
+				sum_subsampled_split_reads1 += adjacent_fusions[k]->subsampled_split_reads1;
+				sum_subsampled_split_reads2 += adjacent_fusions[k]->subsampled_split_reads2;
 			}
 		}
 
@@ -77,6 +79,8 @@ unsigned int merge_adjacent_fusions(fusions_t& fusions, const int max_distance)
 		if (fusion_has_most_support) {
 			(**fusion).split_reads1 += sum_split_reads1;
 			(**fusion).split_reads2 += sum_split_reads2;
+			(**fusion).subsampled_split_reads1 += sum_subsampled_split_reads1;
+			(**fusion).subsampled_split_reads2 += sum_subsampled_split_reads2;
 			for (unsigned int k = 0; k < adjacent_fusions.size(); ++k)
 				adjacent_fusions[k]->filter = FILTER_merge_adjacent;
 		}
@@ -10,6 +10,8 @@
 #include <unordered_map>
 #include "common.hpp"
 #include "annotation.hpp"
+#include "assembly.hpp"
+#include "read_stats.hpp"
 #include "options.hpp"
 
 using namespace std;
@@ -47,6 +49,10 @@ bool output_directory_exists(const string& output_file) {
 	return result;
 }
 
+bool is_cram_file(const string& file_path) {
+	return file_path.size() >= 5 && file_path.substr(file_path.size() - 5) == ".cram";
+}
+
 bool validate_int(const char* optarg, int& value, const int min_value, const int max_value) {
 	if (!str_to_int(optarg, value))
 		return false;
@@ -99,6 +105,10 @@ options_t get_default_options() {
 	options.external_duplicate_marking = false;
 	options.fill_sequence_gaps = false;
 	options.max_itd_length = 100;
+	options.threads = 1;
+	options.coverage_resolution = COVERAGE_RESOLUTION;
+	options.coverage_resolution_given = false;
+	options.load_assembly_on_demand = false;
 
 	return options;
 }
@@ -120,7 +130,7 @@ void print_usage() {
 	     << "Arriba is a fast tool to search for aberrant transcripts such as gene fusions. " << endl
 	     << "It is based on chimeric alignments found by the STAR RNA-Seq aligner." << endl
 	     << endl
-	     << "Usage: arriba [-c Chimeric.out.sam] -x Aligned.out.bam \\" << endl
+	     << "Usage: arriba [-c Chimeric.out.sam] -x Aligned.out.bam | -z coverage.bin \\" << endl
 	     << "              -g annotation.gtf -a assembly.fa [-b blacklists.tsv] [-k known_fusions.tsv] \\" << endl
 	     << "              [-t tags.tsv] [-p protein_domains.gff3] [-d structural_variants_from_WGS.tsv] \\" << endl
 	     << "              -o fusions.tsv [-O fusions.discarded.tsv] \\" << endl
@@ -134,12 +144,39 @@ void print_usage() {
 	     << wrap_help("-x FILE", "File in SAM/BAM/CRAM format with main alignments as "
 	                  "generated by STAR (Aligned.out.sam). Arriba extracts candidate reads "
 	                  "from this file.")
+	     << wrap_help("-z FILE", "Coverage file written by a previous run of Arriba via the "
+	                  "parameter -Z. It takes the place of the parameter -x, such that only the "
+	                  "chimeric alignments given via -c need to be read. This speeds up the "
+	                  "reanalysis of a sample with different filters or parameters. Note that "
+	                  "reads which STAR did not report as chimeric (read-through alignments and "
+	                  "internal tandem duplications recovered from clipped reads) are not "
+	                  "detected in this mode. The assembly must be the same as in the previous run. "
+	                  "The numbers of mapped reads and the resolution of the coverage are taken "
+	                  "from the file.")
+	     << wrap_help("-Z FILE", "Output file to which the coverage and the number of mapped "
+	                  "reads are written after the alignments have been read. The file can "
+	                  "be passed to subsequent runs via the parameter -z.")
 	     << wrap_help("-g FILE", "GTF file with gene annotation. The file may be gzip-compressed.")
+	     << wrap_help("-j FILE", "Cache file for the annotation. If the file exists and was "
+	                  "made from the same GTF file, GTF features (-G), and assembly, the "
+	                  "annotation is loaded from it rather than from the GTF file. Otherwise, "
+	                  "the GTF file is parsed and the cache is (re)written.")
 	     << wrap_help("-G GTF_FEATURES", "Comma-/space-separated list of names of GTF features.\n"
 	                  "Default: " + default_options.gtf_features)
 	     << wrap_help("-a FILE", "FastA file with genome sequence (assembly). "
 	                  "The file may be gzip-compressed. An index with the file extension .fai "
-	                  "must exist only if CRAM files are processed.")
+	                  "must exist only if CRAM files are processed. Alternatively, a binary "
+	                  "assembly written via the parameter -W can be given, which loads much faster.")
+	     << wrap_help("-W FILE", "Output file to which the assembly is written in a binary "
+	                  "format with 2 bits per base. The file can be passed to the parameter -a "
+	                  "in subsequent runs instead of the FastA file. All contigs are written, "
+	                  "not only the ones given by -i. The bases of a binary assembly are decoded "
+	                  "when accessed, not loaded into memory. It cannot be used to decode CRAM files.")
+	     << wrap_help("-n", "Load the sequence of a contig from the assembly only when it is "
+	                  "needed for the first time rather than loading all contigs upfront. This "
+	                  "reduces the memory consumption when the assembly contains many contigs "
+	                  "without reads, such as alternative haplotypes or decoys. Requires an "
+	                  "uncompressed FastA file and an index with the file extension .fai.")
 	     << wrap_help("-b FILE", "File containing blacklisted events (recurrent artifacts "
 	                  "and transcripts observed in healthy tissue).")
 	     << wrap_help("-k FILE", "File containing known/recurrent fusions. Some cancer "
@@ -219,8 +256,11 @@ void print_usage() {
 	                  "Default: " + to_string(static_cast<long long unsigned int>(default_options.fragment_length)))
 	     << wrap_help("-U MAX_READS", "Subsample fusions with more than the given number of "
 	                  "supporting reads. This improves performance without compromising sensitivity, "
-	                  "as long as the threshold is high. Counting of supporting reads beyond "
-	                  "the threshold is inaccurate, obviously. "
+	                  "as long as the threshold is high. Split reads beyond the threshold "
+	                  "randomly replace retained ones, such that they are a uniform sample. "
+	                  "They are still counted in the output, but filters only see the retained "
+	                  "reads. Counting of discordant mates beyond the threshold is inaccurate. "
+	                  "Reads are subsampled after loading, so this does not reduce the memory usage. "
 	                  "Default: " + to_string(static_cast<long long unsigned int>(default_options.subsampling_threshold)))
 	     << wrap_help("-Q QUANTILE", "Highly expressed genes are prone to produce artifacts "
 	                  "during library preparation. Genes with an expression above the given quantile "
@@ -240,6 +280,16 @@ void print_usage() {
 	     << wrap_help("-l MAX_ITD_LENGTH", "Maximum length of internal tandem duplications. Note:  "
 	                  "Increasing this value beyond the default can impair performance and lead to "
 	                  "many false positives. Default: " + to_string(static_cast<long long unsigned int>(default_options.max_itd_length)))
+	     << wrap_help("-@ THREADS", "Number of threads to use for decompression of the "
+	                  "input files given via -x and -c and for the extraction of chimeric "
+	                  "reads. Half of the threads (at least one) extract chimeric reads, the "
+	                  "others decompress. When the file given via -x is coordinate-sorted and "
+	                  "indexed, multiple contigs are read in parallel. The GTF file is parsed by "
+	                  "the full number of threads. Default: " + to_string(static_cast<long long unsigned int>(default_options.threads)))
+	     << wrap_help("-w COVERAGE_RESOLUTION", "Resolution in bp at which the coverage is "
+	                  "computed for the columns coverage1/coverage2 and for filters which "
+	                  "consider the coverage around breakpoints. Higher values save memory, "
+	                  "but make the coverage less precise. Default: " + to_string(static_cast<long long unsigned int>(default_options.coverage_resolution)))
 	     << wrap_help("-u", "Instead of performing duplicate marking itself, Arriba relies on "
 	                  "duplicate marking by a preceding program using the BAM_FDUP flag. This "
 	                  "makes sense when unique molecular identifiers (UMI) are used.")
@@ -270,7 +320,7 @@ options_t parse_arguments(int argc, char **argv) {
 	int c;
 	string junction_suffix(".junction");
 	unordered_map<char,unsigned int> duplicate_arguments;
-	const string valid_arguments = "c:x:d:g:G:o:O:t:p:a:b:k:s:i:v:f:E:S:m:L:H:D:R:A:M:K:V:F:U:Q:e:T:C:l:uXIh";
+	const string valid_arguments = "c:x:z:Z:d:g:j:G:o:O:t:p:a:W:b:k:s:i:v:f:E:S:m:L:H:D:R:A:M:K:V:F:U:Q:e:T:C:l:@:w:nuXIh";
 	while ((c = getopt(argc, argv, valid_arguments.c_str())) != -1) {
 
 		// throw error if the same argument is specified more than once
@@ -291,6 +341,14 @@ options_t parse_arguments(int argc, char **argv) {
 				crash(access(options.rna_bam_file.c_str(), R_OK), "file not found/readable: " + options.rna_bam_file);
 				break;
 			}
+			case 'z':
+				options.coverage_file = optarg;
+				crash(access(options.coverage_file.c_str(), R_OK), "file not found/readable: " + options.coverage_file);
+				break;
+			case 'Z':
+				options.coverage_output_file = optarg;
+				crash(!output_directory_exists(options.coverage_output_file), "parent directory of output file '" + options.coverage_output_file + "' does not exist");
+				break;
 			case 'd':
 				options.genomic_breakpoints_file = optarg;
 				crash(access(options.genomic_breakpoints_file.c_str(), R_OK), "file not found/readable: " + options.genomic_breakpoints_file);
@@ -299,6 +357,10 @@ options_t parse_arguments(int argc, char **argv) {
 				options.gene_annotation_file = optarg;
 				crash(access(options.gene_annotation_file.c_str(), R_OK), "file not found/readable: " + options.gene_annotation_file);
 				break;
+			case 'j':
+				options.annotation_cache_file = optarg;
+				crash(!output_directory_exists(options.annotation_cache_file), "parent directory of output file '" + options.annotation_cache_file + "' does not exist");
+				break;
 			case 'G':
 				options.gtf_features = optarg;
 				{
@@ -327,9 +389,16 @@ options_t parse_arguments(int argc, char **argv) {
 				options.assembly_file = optarg;
 				crash(access(options.assembly_file.c_str(), R_OK), "file not found/readable: " + options.assembly_file);
 				// when CRAM files are used, the FastA file must be indexed
-				if (options.rna_bam_file.size() >= 5 && options.rna_bam_file.substr(options.rna_bam_file.size()-5) == ".cram")
+				if (is_cram_file(options.rna_bam_file))
 					crash(access((options.assembly_file + ".fai").c_str(), R_OK), "index file not found/readable: " + options.assembly_file + ".fai");
 				break;
+			case 'n':
+				options.load_assembly_on_demand = true;
+				break;
+			case 'W':
+				options.binary_assembly_file = optarg;
+				crash(!output_directory_exists(options.binary_assembly_file), "parent directory of output file '" + options.binary_assembly_file + "' does not exist");
+				break;
 			case 'b':
 				options.blacklist_file = optarg;
 				crash(access(options.blacklist_file.c_str(), R_OK), "file not found/readable: " + options.blacklist_file);
@@ -428,6 +497,13 @@ options_t parse_arguments(int argc, char **argv) {
 			case 'l':
 				crash(!validate_int(optarg, options.max_itd_length, 1), "argument to -" + ((char) c) + " must be an integer greater than 0");
 				break;
+			case '@':
+				crash(!validate_int(optarg, options.threads, 1), "argument to -" + ((char) c) + " must be an integer greater than 0");
+				break;
+			case 'w':
+				crash(!validate_int(optarg, options.coverage_resolution, 1), "argument to -" + ((char) c) + " must be an integer greater than 0");
+				options.coverage_resolution_given = true;
+				break;
 			case 'u':
 				options.external_duplicate_marking = true;
 				break;
@@ -456,10 +532,13 @@ options_t parse_arguments(int argc, char **argv) {
 		print_usage();
 		crash(true, "no arguments given");
 	}
-	crash(options.rna_bam_file.empty(), "missing mandatory option -x");
+	crash(options.rna_bam_file.empty() && options.coverage_file.empty(), "missing mandatory option -x");
+	crash(!options.rna_bam_file.empty() && !options.coverage_file.empty(), "options -x and -z are mutually exclusive");
+	crash(!options.coverage_file.empty() && options.chimeric_bam_file.empty(), "option -z requires option -c");
 	crash(options.gene_annotation_file.empty(), "missing mandatory option -g");
 	crash(options.output_file.empty(), "missing mandatory option -o");
 	crash(options.assembly_file.empty(), "missing mandatory option -a");
+	crash((is_cram_file(options.rna_bam_file) || is_cram_file(options.chimeric_bam_file)) && is_binary_assembly(options.assembly_file), "CRAM files cannot be decoded with a binary assembly, the assembly passed to -a must be a FastA file");
 	crash(options.filters["blacklist"] && options.blacklist_file.empty(), "filter 'blacklist' enabled, but missing option -b (use '-f blacklist' if you want to disable the blacklist)");
 
 	return options;
@@ -25,14 +25,19 @@ bool validate_float(const char* optarg, float& value, const float min_value = FL
 struct options_t {
 	string chimeric_bam_file;
 	string rna_bam_file;
+	string coverage_file;
+	string coverage_output_file;
 	string genomic_breakpoints_file;
 	unsigned int max_genomic_breakpoint_distance;
 	string gene_annotation_file;
+	string annotation_cache_file;
 	string exon_annotation_file;
 	string known_fusions_file;
 	string output_file;
 	string discarded_output_file;
 	string assembly_file;
+	string binary_assembly_file;
+	bool load_assembly_on_demand;
 	string blacklist_file;
 	string interesting_contigs;
 	string viral_contigs;
@@ -61,6 +66,9 @@ struct options_t {
 	string protein_domains_file;
 	bool fill_sequence_gaps;
 	unsigned int max_itd_length;
+	unsigned int threads;
+	unsigned int coverage_resolution;
+	bool coverage_resolution_given;
 };
 
 options_t parse_arguments(int argc, char **argv);
@@ -37,7 +37,7 @@ void pileup_chimeric_alignments(vector<chimeric_alignments_t::iterator>& chimeri
 			      direction == UPSTREAM   && read.strand == REVERSE && read.start >= breakpoint-2 && read.start <= breakpoint+200)) // only consider discordant mates close to the breakpoints (we don't care about the ones in other exons)
 				continue;
 
-		string read_sequence = (mate == SUPPLEMENTARY) ? (**chimeric_alignment).second[SPLIT_READ].sequence : read.sequence;
+		string read_sequence = ((mate == SUPPLEMENTARY) ? (**chimeric_alignment).second[SPLIT_READ].sequence : read.sequence).substr(); // unpack sequence once for the pileup
 		if (reverse_complement)
 			read_sequence = dna_to_reverse_complement(read_sequence);
 
@@ -114,9 +114,8 @@ void get_sequence_from_pileup(const pileup_t& pileup, const position_t breakpoin
 
 		// find out base in reference to mark SNPs/SNVs
 		string reference_base = "N";
-		assembly_t::const_iterator contig_sequence = assembly.find(gene->contig);
-		if (contig_sequence != assembly.end())
-			reference_base = contig_sequence->second[position->first];
+		if (assembly.count(gene->contig))
+			reference_base = assembly.at(gene->contig)[position->first];
 
 		// find most frequent allele at current position and compute coverage
 		auto most_frequent_base = position->second.end();
@@ -750,8 +749,8 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 
 	// fill gaps in 5' end of transcript
 	if (transcript_5 != NULL) {
-		assembly_t::const_iterator contig_sequence = assembly.find(transcript_5->first_exon->contig);
-		if (contig_sequence != assembly.end()) {
+		if (assembly.count(transcript_5->first_exon->contig)) {
+			contig_sequence_t contig_sequence = assembly.at(transcript_5->first_exon->contig);
 
 			// find gap closest to the breakpoint junction, we complete the sequence starting from there
 			auto breakpoint = transcript_sequence.find('|');
@@ -814,7 +813,7 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 				if (imprecise_breakpoint) {
 					gap = breakpoint - 1;
 					positions[gap] = (strand_5 == FORWARD) ? overlapping_exon->end : overlapping_exon->start;
-					transcript_sequence[gap] = contig_sequence->second[positions[gap]];
+					transcript_sequence[gap] = contig_sequence[positions[gap]];
 				}
 
 				// copy assembly sequence from exons of transcript
@@ -823,7 +822,7 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 				for (exon_t exon = (strand_5 == FORWARD) ? transcript_5->first_exon : transcript_5->last_exon; exon != NULL; exon = (strand_5 == FORWARD) ? exon->next_exon : exon->previous_exon) {
 					position_t position;
 					for (position = (strand_5 == FORWARD) ? exon->start : exon->end; position != positions[gap] && position >= exon->start && position <= exon->end; position += (strand_5 == FORWARD) ? +1 : -1) {
-						sequence_from_assembly += (strand_5 == FORWARD) ? contig_sequence->second[position] : dna_to_complement(contig_sequence->second[position]);
+						sequence_from_assembly += (strand_5 == FORWARD) ? contig_sequence[position] : dna_to_complement(contig_sequence[position]);
 						positions_from_assembly.push_back(position);
 					}
 					if (position == positions[gap])
@@ -860,8 +859,8 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 	// fill gaps in 3' end of transcript
 	three_prime_end:
 	if (transcript_3 != NULL) {
-		assembly_t::const_iterator contig_sequence = assembly.find(transcript_3->first_exon->contig);
-		if (contig_sequence != assembly.end()) {
+		if (assembly.count(transcript_3->first_exon->contig)) {
+			contig_sequence_t contig_sequence = assembly.at(transcript_3->first_exon->contig);
 
 			// find gap closest to the breakpoint junction, we complete the sequence starting from there
 			size_t breakpoint = transcript_sequence.find_last_of('|');
@@ -924,7 +923,7 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 				if (imprecise_breakpoint) {
 					gap = breakpoint + 1;
 					positions[gap] = (strand_3 == FORWARD) ? overlapping_exon->start : overlapping_exon->end;
-					transcript_sequence[gap] = contig_sequence->second[positions[gap]];
+					transcript_sequence[gap] = contig_sequence[positions[gap]];
 				}
 
 				// copy assembly sequence from exons of transcript
@@ -932,7 +931,7 @@ void fill_gaps_in_fusion_transcript_sequence(string& transcript_sequence, vector
 				vector<position_t> positions_from_assembly;
 				for (exon_t exon = overlapping_exon; exon != NULL; exon = (strand_3 == FORWARD) ? exon->next_exon : exon->previous_exon) {
 					for (position_t position = (strand_3 == FORWARD) ? max(exon->start, positions[gap]+1) : min(exon->end, positions[gap]-1); position >= exon->start && position <= exon->end; position += (strand_3 == FORWARD) ? +1 : -1) {
-						sequence_from_assembly += (strand_3 == FORWARD) ? contig_sequence->second[position] : dna_to_complement(contig_sequence->second[position]);
+						sequence_from_assembly += (strand_3 == FORWARD) ? contig_sequence[position] : dna_to_complement(contig_sequence[position]);
 						positions_from_assembly.push_back(position);
 					}
 					if ((strand_3 == FORWARD) && exon->next_exon != NULL || (strand_3 == REVERSE) && exon->previous_exon != NULL) {
@@ -1030,7 +1029,7 @@ void write_fusions_to_file(fusions_t& fusions, const string& output_file, const
 		contig_t contig_5 = (**fusion).contig1; contig_t contig_3 = (**fusion).contig2;
 		position_t breakpoint_5 = (**fusion).breakpoint1; position_t breakpoint_3 = (**fusion).breakpoint2;
 		direction_t direction_5 = (**fusion).direction1; direction_t direction_3 = (**fusion).direction2;
-		unsigned int split_reads_5 = (**fusion).split_reads1; unsigned int split_reads_3 = (**fusion).split_reads2;
+		unsigned int split_reads_5 = (**fusion).split_reads1 + (**fusion).subsampled_split_reads1; unsigned int split_reads_3 = (**fusion).split_reads2 + (**fusion).subsampled_split_reads2;
 		strand_t strand_5 = (**fusion).predicted_strand1; strand_t strand_3 = (**fusion).predicted_strand2;
 		position_t closest_genomic_breakpoint_5 = (**fusion).closest_genomic_breakpoint1; position_t closest_genomic_breakpoint_3 = (**fusion).closest_genomic_breakpoint2;
 		if ((**fusion).transcript_start == TRANSCRIPT_START_GENE2) {
@@ -1175,7 +1174,7 @@ void write_fusions_to_file(fusions_t& fusions, const string& output_file, const
 			for (auto read = all_supporting_reads.begin(); read != all_supporting_reads.end(); ++read) {
 				if (read != all_supporting_reads.begin())
 					out << ",";
-				out << strip_hi_tag_from_read_name((**read).first);
+				out << (**read).first.name;
 			}
 		} else {
 			out << ".";
@@ -1,11 +1,18 @@
 #include <algorithm>
+#include <atomic>
 #include <climits>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "cram.h"
+#include "hts.h"
 #include "htrie_map.h"
 #include "sam.h"
+#include "thread_pool.h"
 #include "annotation.hpp"
 #include "common.hpp"
 #include "read_chimeric_alignments.hpp"
@@ -16,6 +23,210 @@ using namespace std;
 typedef tsl::htrie_map<char,bam1_t*> collated_bam_records_t;
 typedef vector<contig_t> tid_to_contig_t;
 
+// BAM records are decoded in batches of this size, which are passed from the reader thread to the consumers
+const unsigned int BAM_RECORD_BATCH_SIZE = 4096;
+// maximum number of batches in flight between the reader thread and the consumers
+const unsigned int BAM_RECORD_BATCH_COUNT = 8;
+
+struct bam_record_batch_t {
+	vector<bam1_t*> records; // records are allocated on demand and reused when the batch is recycled
+	vector<unsigned int> shards; // shard of each record as given by the hash of the read name
+	unsigned int size; // number of valid records in the batch
+	unsigned int pending_consumers; // number of consumers which have not yet finished processing the batch
+};
+
+// every consumer walks through all batches, but only sees the records of its own shard
+struct bam_record_cursor_t {
+	unsigned int shard;
+	unsigned long int batch_number;
+	bam_record_batch_t* batch;
+	unsigned int record;
+};
+
+// assign reads to shards by name, such that all alignments of a read end up in the same shard
+unsigned int get_shard(const char* read_name, const size_t length, const unsigned int shards) {
+	uint32_t hash = 2166136261U; // FNV-1a
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (unsigned char) read_name[i];
+		hash *= 16777619U;
+	}
+	return hash % shards;
+}
+
+// read BAM records in batches, optionally in a separate thread,
+// such that decoding of records overlaps with the extraction of chimeric reads
+class bam_record_reader_t {
+	public:
+		bam_record_reader_t(samFile* bam_file, bam_hdr_t* bam_header, const bool asynchronous, const unsigned int shards);
+		~bam_record_reader_t();
+		bam1_t* next_record(bam_record_cursor_t& cursor); // returns NULL when all records have been read
+		void keep_record(bam_record_cursor_t& cursor, bam1_t* replacement); // the caller takes over ownership of the record returned last by next_record() and hands over a replacement (or NULL)
+		int status; // return value of the last call to sam_read1()
+	private:
+		void fill_batch(bam_record_batch_t* batch);
+		void read_batches();
+		bam_record_batch_t* get_batch(const unsigned long int batch_number);
+		void recycle_batch(bam_record_batch_t* batch);
+		samFile* bam_file;
+		bam_hdr_t* bam_header;
+		bool asynchronous;
+		unsigned int shards;
+		vector<bam_record_batch_t> batches;
+		deque<bam_record_batch_t*> empty_batches, full_batches;
+		unsigned long int first_full_batch_number; // number of the batch at the front of <full_batches>
+		bool end_of_file;
+		mutex batches_mutex;
+		condition_variable batches_changed;
+		thread reader_thread;
+};
+
+bam_record_reader_t::bam_record_reader_t(samFile* bam_file, bam_hdr_t* bam_header, const bool asynchronous, const unsigned int shards): status(0), bam_file(bam_file), bam_header(bam_header), asynchronous(asynchronous), shards(shards), first_full_batch_number(0), end_of_file(false) {
+	crash(!asynchronous && shards > 1, "multiple shards require asynchronous reading");
+	batches.resize(asynchronous ? BAM_RECORD_BATCH_COUNT : 1);
+	for (auto batch = batches.begin(); batch != batches.end(); ++batch) {
+		batch->records.resize(BAM_RECORD_BATCH_SIZE, NULL);
+		if (shards > 1)
+			batch->shards.resize(BAM_RECORD_BATCH_SIZE);
+		batch->size = 0;
+		batch->pending_consumers = 0;
+		empty_batches.push_back(&(*batch));
+	}
+	if (asynchronous)
+		reader_thread = thread(&bam_record_reader_t::read_batches, this);
+}
+
+bam_record_reader_t::~bam_record_reader_t() {
+	if (reader_thread.joinable())
+		reader_thread.join();
+	for (auto batch = batches.begin(); batch != batches.end(); ++batch)
+		for (auto bam_record = batch->records.begin(); bam_record != batch->records.end(); ++bam_record)
+			if (*bam_record != NULL)
+				bam_destroy1(*bam_record);
+}
+
+void bam_record_reader_t::fill_batch(bam_record_batch_t* batch) {
+	for (batch->size = 0; batch->size < batch->records.size(); ++batch->size) {
+		bam1_t*& bam_record = batch->records[batch->size];
+		if (bam_record == NULL) { // the previous record in this slot was kept by a consumer => allocate a new one
+			bam_record = bam_init1();
+			crash(bam_record == NULL, "failed to allocate memory");
+		}
+		if ((status = sam_read1(bam_file, bam_header, bam_record)) < 0)
+			break;
+		if (shards > 1)
+			batch->shards[batch->size] = get_shard(bam_get_qname(bam_record), bam_record->core.l_qname - bam_record->core.l_extranul - 1, shards);
+	}
+	batch->pending_consumers = shards;
+}
+
+// this function runs in a separate thread and fills empty batches until the end of the file is reached
+void bam_record_reader_t::read_batches() {
+	bool last_batch = false;
+	while (!last_batch) {
+		bam_record_batch_t* batch;
+		{
+			unique_lock<mutex> lock(batches_mutex);
+			batches_changed.wait(lock, [this]{ return !empty_batches.empty(); });
+			batch = empty_batches.front();
+			empty_batches.pop_front();
+		}
+		fill_batch(batch);
+		last_batch = batch->size < batch->records.size();
+		{
+			lock_guard<mutex> lock(batches_mutex);
+			full_batches.push_back(batch);
+			end_of_file = last_batch;
+		}
+		batches_changed.notify_all();
+	}
+}
+
+bam_record_batch_t* bam_record_reader_t::get_batch(const unsigned long int batch_number) {
+	if (asynchronous) {
+		unique_lock<mutex> lock(batches_mutex);
+		batches_changed.wait(lock, [&]{ return batch_number < first_full_batch_number + full_batches.size() || end_of_file; });
+		if (batch_number >= first_full_batch_number + full_batches.size())
+			return NULL; // all batches have been consumed
+		return full_batches[batch_number - first_full_batch_number];
+	} else {
+		if (end_of_file)
+			return NULL;
+		fill_batch(&batches[0]);
+		end_of_file = batches[0].size < batches[0].records.size();
+		return &batches[0];
+	}
+}
+
+void bam_record_reader_t::recycle_batch(bam_record_batch_t* batch) {
+	if (asynchronous) {
+		{
+			lock_guard<mutex> lock(batches_mutex);
+			batch->pending_consumers--;
+			// batches are recycled in the order they were read, once all consumers are done with them
+			while (!full_batches.empty() && full_batches.front()->pending_consumers == 0) {
+				empty_batches.push_back(full_batches.front());
+				full_batches.pop_front();
+				first_full_batch_number++;
+			}
+		}
+		batches_changed.notify_all();
+	}
+}
+
+bam1_t* bam_record_reader_t::next_record(bam_record_cursor_t& cursor) {
+	if (cursor.batch != NULL)
+		cursor.record++;
+	for (;;) {
+		if (cursor.batch == NULL || cursor.record >= cursor.batch->size) { // move on to the next batch
+			if (cursor.batch != NULL) {
+				recycle_batch(cursor.batch);
+				cursor.batch_number++;
+			}
+			cursor.batch = get_batch(cursor.batch_number);
+			cursor.record = 0;
+			if (cursor.batch == NULL)
+				return NULL;
+		} else if (shards > 1 && cursor.batch->shards[cursor.record] != cursor.shard) {
+			cursor.record++; // record belongs to another shard
+		} else {
+			return cursor.batch->records[cursor.record];
+		}
+	}
+}
+
+void bam_record_reader_t::keep_record(bam_record_cursor_t& cursor, bam1_t* replacement) {
+	cursor.batch->records[cursor.record] = replacement; // if no replacement is given, the reader allocates a new record for this slot the next time the batch is filled
+}
+
+// chimeric reads and read counts extracted by one thread from the records of its shard (or region)
+struct bam_record_shard_t {
+	bam_record_cursor_t cursor;
+	collated_bam_records_t collated_bam_records; // holds the first mate until we have found the second
+	string collation_key; // buffer for the keys of <collated_bam_records>
+	vector<bam1_t*> recycled_bam_records; // records of completed pairs, which replace the records kept in <collated_bam_records> to avoid allocations
+	chimeric_alignments_t chimeric_alignments;
+	coverage_t coverage; // each thread computes the coverage of its records separately, the shards are merged at the end
+	unsigned long int mapped_reads;
+	vector<unsigned long int> mapped_viral_reads_by_contig;
+	bool no_chimeric_reads;
+	unsigned int missing_hi_tag;
+	unsigned int malformed_count;
+	bam_record_shard_t(): mapped_reads(0), no_chimeric_reads(true), missing_hi_tag(0), malformed_count(0) {};
+	bam1_t* get_recycled_bam_record() { // returns NULL, if there is none
+		if (recycled_bam_records.empty())
+			return NULL;
+		bam1_t* bam_record = recycled_bam_records.back();
+		recycled_bam_records.pop_back();
+		return bam_record;
+	};
+};
+
+// when an indexed BAM file is read by region, the results are merged in the order of the regions
+struct bam_record_region_t {
+	chimeric_alignments_t chimeric_alignments;
+	vector<bam1_t*> unpaired_mates; // mates whose partner is in a different region
+};
+
 bool find_spanning_intron(const bam1_t* bam_record, const position_t gene1_end, const position_t gene2_start, unsigned int& cigar_op, position_t& read_pos) {
 
 	if (bam_record->core.n_cigar < 3)
@@ -44,6 +255,71 @@ inline strand_t get_strand(const bam1_t* bam_record) {
 	return (bam_record->core.flag & BAM_FREVERSE) ? REVERSE : FORWARD;
 }
 
+// a record can only be a split read or have a supplementary alignment, if it is clipped
+inline bool is_clipped(const bam1_t* bam_record) {
+	if (bam_record->core.n_cigar == 0)
+		return false;
+	uint32_t first_op = bam_cigar_op(bam_get_cigar(bam_record)[0]);
+	uint32_t last_op = bam_cigar_op(bam_get_cigar(bam_record)[bam_record->core.n_cigar-1]);
+	return first_op == BAM_CSOFT_CLIP || first_op == BAM_CHARD_CLIP || last_op == BAM_CSOFT_CLIP || last_op == BAM_CHARD_CLIP;
+}
+
+// size of an element of an aux array of type 'B'
+inline unsigned int aux_array_element_size(const uint8_t subtype) {
+	switch (subtype) {
+		case 'c': case 'C': return 1;
+		case 's': case 'S': return 2;
+		case 'i': case 'I': case 'f': return 4;
+		default: return 0;
+	}
+}
+
+// find HI and SA tags in a single pass over the aux data (as opposed to calling bam_aux_get() for each tag)
+// the pointers are set to the type of the tag like those returned by bam_aux_get()
+void find_hi_and_sa_tags(const bam1_t* bam_record, uint8_t*& hi_tag, uint8_t*& sa_tag) {
+	hi_tag = NULL;
+	sa_tag = NULL;
+	uint8_t* aux = bam_get_aux(bam_record);
+	uint8_t* aux_end = bam_record->data + bam_record->l_data;
+	while (aux + 3 <= aux_end && (hi_tag == NULL || sa_tag == NULL)) {
+		if (hi_tag == NULL && aux[0] == 'H' && aux[1] == 'I')
+			hi_tag = aux + 2;
+		else if (sa_tag == NULL && aux[0] == 'S' && aux[1] == 'A')
+			sa_tag = aux + 2;
+		uint8_t type = aux[2];
+		aux += 3;
+		switch (type) { // skip value
+			case 'A': case 'c': case 'C': aux += 1; break;
+			case 's': case 'S': aux += 2; break;
+			case 'i': case 'I': case 'f': aux += 4; break;
+			case 'd': aux += 8; break;
+			case 'Z': case 'H':
+				while (aux < aux_end && *aux != '\0')
+					aux++;
+				aux++;
+				break;
+			case 'B': {
+				if (aux + 5 > aux_end)
+					return;
+				uint32_t count;
+				memcpy(&count, aux + 1, sizeof(count));
+				aux += 5 + (size_t) count * aux_array_element_size(aux[0]);
+				break;
+			}
+			default: return; // malformed aux data
+		}
+	}
+}
+
+// on the fast path for unremarkable records, the HI tag is not looked up until the read is actually stored
+const int UNKNOWN_HIT_INDEX = INT_MIN;
+inline void resolve_hit_index(read_name_t& read_name, const bam1_t* bam_record) {
+	if (read_name.hit_index == UNKNOWN_HIT_INDEX) {
+		uint8_t* hi_tag = bam_aux_get(bam_record, "HI");
+		read_name.hit_index = (hi_tag != NULL) ? bam_aux2i(hi_tag) : 1;
+	}
+}
+
 const unsigned char CLIP_NONE = 0;
 const unsigned char CLIP_START = 1;
 const unsigned char CLIP_END = 2;
@@ -59,9 +335,7 @@ void add_chimeric_alignment(mates_t& mates, const bam1_t* bam_record, const bool
 	alignment.contig = bam_record->core.tid;
 	alignment.supplementary = is_supplementary;
 	if (!is_supplementary) { // only keep sequence in memory, if this is not the supplementary alignment (because then it's already stored in the split-read)
-		alignment.sequence.resize(bam_record->core.l_qseq);
-		for (int i = 0; i < bam_record->core.l_qseq; ++i)
-			alignment.sequence[i] = seq_nt16_str[bam_seqi(bam_get_seq(bam_record), i)];
+		alignment.sequence.assign(bam_get_seq(bam_record), bam_record->core.l_qseq);
 	}
 
 	// read-through alignments need to be split into a split-read and a supplementary alignment
@@ -88,12 +362,41 @@ void add_chimeric_alignment(mates_t& mates, const bam1_t* bam_record, const bool
 	}
 }
 
-bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments, const string& read_name, bam1_t* forward_mate, bam1_t* reverse_mate, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file) {
+// for each contig, the positions where the set of overlapping genes changes (i.e., the keys of the gene annotation index)
+typedef vector< vector<position_t> > gene_boundaries_t;
+
+void make_gene_boundaries(const gene_annotation_index_t& gene_annotation_index, gene_boundaries_t& gene_boundaries) {
+	gene_boundaries.resize(gene_annotation_index.size());
+	for (contig_t contig = 0; contig < (contig_t) gene_annotation_index.size(); ++contig) {
+		gene_boundaries[contig].reserve(gene_annotation_index[contig].size());
+		for (gene_contig_annotation_index_t::const_iterator region = gene_annotation_index[contig].begin(); region != gene_annotation_index[contig].end(); ++region)
+			gene_boundaries[contig].push_back(region->first);
+	}
+}
+
+// check if two positions fall into the same region of the gene annotation index and thus overlap with the same genes
+// this is equivalent to get_annotation_by_coordinate() returning the same gene set for both positions, but does not allocate memory
+inline bool in_same_gene_region(const gene_boundaries_t& gene_boundaries, const contig_t contig, position_t position1, position_t position2) {
+	if ((unsigned int) contig >= gene_boundaries.size())
+		return true; // no genes on this contig
+	if (position1 > position2)
+		swap(position1, position2);
+	vector<position_t>::const_iterator region = lower_bound(gene_boundaries[contig].begin(), gene_boundaries[contig].end(), position1);
+	return region == gene_boundaries[contig].end() || *region >= position2;
+}
+
+bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments, read_name_t& read_name, bam1_t* forward_mate, bam1_t* reverse_mate, const gene_annotation_index_t& gene_annotation_index, const gene_boundaries_t& gene_boundaries) {
 
 	// find out which read is on the forward strand and which on the reverse
 	if (get_strand(forward_mate) == REVERSE)
 		swap(forward_mate, reverse_mate);
 
+	// most pairs start and end in the same gene (or in the same intergenic region) => discard them without looking up the genes
+	const bam1_t* start_mate = (forward_mate != NULL) ? forward_mate : reverse_mate;
+	const bam1_t* end_mate = (reverse_mate != NULL) ? reverse_mate : forward_mate;
+	if (start_mate->core.tid == end_mate->core.tid && in_same_gene_region(gene_boundaries, start_mate->core.tid, start_mate->core.pos, bam_endpos(end_mate)))
+		return false;
+
 	// check if one mate maps inside the gene and the other outside
 	gene_set_t forward_mate_genes, reverse_mate_genes;
 	if (forward_mate != NULL)
@@ -134,7 +437,8 @@ bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments,
 		    (!reverse_mate_has_intron || forward_read_pos < reverse_mate->core.l_qseq - reverse_read_pos)) { // if both mates are clipped, use the one with the longer segment as anchor
 
 			// store read-through alignments, unless they are already stored as chimeric alignments
-			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(pair<string,mates_t>(read_name, mates_t()));
+			resolve_hit_index(read_name, forward_mate);
+			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(read_name);
 			if (mates.second) { // insertion succeeded => the alignments have not been stored previously
 
 				// make split read and supplementary from forward mate
@@ -154,7 +458,8 @@ bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments,
 		} else if (reverse_mate_has_intron) {
 
 			// add read-through alignments, unless they are already stored as chimeric alignments
-			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(pair<string,mates_t>(read_name, mates_t()));
+			resolve_hit_index(read_name, reverse_mate);
+			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(read_name);
 			if (mates.second) { // insertion succeeded => the alignments have not been stored previously
 
 				// make split read and supplementary from reverse mate
@@ -177,7 +482,8 @@ bool extract_read_through_alignment(chimeric_alignments_t& chimeric_alignments,
 		           bam_endpos(forward_mate) <= forward_gene_end) {
 
 			// add read-through alignments, unless they are already stored as chimeric alignments
-			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(pair<string,mates_t>(read_name, mates_t()));
+			resolve_hit_index(read_name, reverse_mate);
+			pair<chimeric_alignments_t::iterator,bool> mates = chimeric_alignments.insert(read_name);
 			if (mates.second) { // insertion succeeded => the alignments have not been stored previously
 				add_chimeric_alignment(mates.first->second, forward_mate);
 				add_chimeric_alignment(mates.first->second, reverse_mate);
@@ -208,6 +514,76 @@ bool clipped_sequence_is_adapter(const bam1_t* mate1, const bam1_t* mate2) {
 	return false;
 }
 
+inline int encode_base(const char base) {
+	switch (base) {
+		case 'A': return 0;
+		case 'C': return 1;
+		case 'G': return 2;
+		case 'T': return 3;
+		default: return -1;
+	}
+}
+
+// find the positions in the window [window_start, window_end] at which at least one k-mer of the given sequence aligns without mismatches
+// to this end, the k-mers of the contig sequence in the window are indexed and then looked up for each k-mer of the sequence
+// returns false, if the sequence contains bases other than A, C, G, and T, which cannot be indexed
+// the index is kept in per-thread buffers, which are reused across calls, because this function is called for every clipped read
+bool find_seeded_alignment_positions(const string& contig_sequence, const int window_start, const int window_end, const string& sequence, const unsigned int seed_length, vector<bool>& candidates) {
+
+	if (window_end < window_start || sequence.size() < seed_length)
+		return false;
+	for (string::const_iterator base = sequence.begin(); base != sequence.end(); ++base)
+		if (encode_base(*base) < 0)
+			return false;
+
+	// make a linked list of occurrences for each k-mer in the contig sequence
+	// (entries of <next_occurrence> are only read after they have been written in the same call, so they need not be reset)
+	const uint32_t kmer_mask = (1 << (2 * seed_length)) - 1;
+	const int text_length = window_end - window_start + sequence.size();
+	static thread_local vector<int> first_occurrence_buffer;
+	static thread_local vector<int> next_occurrence_buffer;
+	if (first_occurrence_buffer.size() < kmer_mask + 1)
+		first_occurrence_buffer.resize(kmer_mask + 1, -1);
+	if (next_occurrence_buffer.size() < (size_t) text_length)
+		next_occurrence_buffer.resize(text_length);
+	// plain pointers let the compiler keep the buffers in registers in the loops below
+	int* first_occurrence = first_occurrence_buffer.data();
+	int* next_occurrence = next_occurrence_buffer.data();
+	uint32_t kmer = 0;
+	unsigned int valid_bases = 0;
+	for (int i = 0; i < text_length; ++i) {
+		int base = encode_base(contig_sequence[window_start + i]);
+		if (base < 0) { // k-mers with ambiguous bases never match the sequence
+			valid_bases = 0;
+			continue;
+		}
+		kmer = ((kmer << 2) | base) & kmer_mask;
+		if (++valid_bases >= seed_length) {
+			int occurrence = i + 1 - seed_length;
+			next_occurrence[occurrence] = first_occurrence[kmer];
+			first_occurrence[kmer] = occurrence;
+		}
+	}
+
+	// mark the alignment positions implied by the k-mers of the sequence
+	candidates.assign(window_end - window_start + 1, false);
+	kmer = 0;
+	for (unsigned int i = 0; i < sequence.size(); ++i) {
+		kmer = ((kmer << 2) | encode_base(sequence[i])) & kmer_mask;
+		if (i + 1 >= seed_length)
+			for (int occurrence = first_occurrence[kmer]; occurrence >= 0; occurrence = next_occurrence[occurrence]) {
+				int offset = occurrence - (i + 1 - seed_length);
+				if (offset >= 0 && offset <= window_end - window_start)
+					candidates[offset] = true;
+			}
+	}
+
+	// the window is usually about as long as the table of k-mers, so clearing the whole table is faster than tracking the touched entries
+	fill(first_occurrence, first_occurrence + kmer_mask + 1, -1);
+
+	return true;
+}
+
 // STAR is bad at aligning internal tandem duplications
 // => if we see a clipped read, check manually if it can be aligned as a tandem duplication
 bool is_tandem_duplication(const bam1_t* bam_record, const assembly_t& assembly, const unsigned int max_itd_length, alignment_t& tandem_alignment) {
@@ -250,20 +626,37 @@ bool is_tandem_duplication(const bam1_t* bam_record, const assembly_t& assembly,
 	if (clipped_sequence_length == 0)
 		return false; // read is not clipped
 
-	if (assembly.find(bam_record->core.tid) == assembly.end())
+	if (!assembly.count(bam_record->core.tid))
 		return false; // contig sequence unavailable and thus no way to make an alignment
-	const string& contig_sequence = assembly.at(bam_record->core.tid);
+	contig_sequence_t contig_sequence = assembly.at(bam_record->core.tid);
 	if (alignment_window_end + max_duplication_length + clipped_sequence_length + 1 >= contig_sequence.size() ||
 	    alignment_window_start <= (int) (max_duplication_length + clipped_sequence_length + 1))
 		return false; // ignore alignments close to contig boundaries to avoid array out-of-bounds errors
 
+	// decode the part of the contig which the clipped sequence can be aligned to only once
+	static thread_local string window_sequence; // reused, because this is called for every clipped read
+	contig_sequence.copy(alignment_window_start, alignment_window_end - alignment_window_start + clipped_sequence_length, window_sequence);
+
 	// try to align clipped sequence in a window of size <max_duplication_length>
 	string clipped_sequence;
 	clipped_sequence.resize(clipped_sequence_length);
 	for (unsigned int i = 0; i < clipped_sequence_length; ++i)
 		clipped_sequence[i] = seq_nt16_str[bam_seqi(bam_get_seq(bam_record), clipped_sequence_position + i)];
+
+	// to satisfy the criteria below, an alignment must contain a stretch of at least 5 matching bases:
+	// - for <min_alignment_length> matches, at least 9 must be beyond the <max_non_template_bases> and these are interrupted by at most one mismatch
+	// - for a full-length alignment, at least 11 of the (at least 12) clipped bases are interrupted by at most one mismatch
+	// => we only try to align at positions where a 5-mer of the clipped sequence matches exactly (unless the clipped sequence contains N's)
+	const unsigned int seed_length = 5;
+	static thread_local vector<bool> candidate_positions_buffer; // reused, because this is called for every clipped read
+	vector<bool>& candidate_positions = candidate_positions_buffer;
+	bool seeded = find_seeded_alignment_positions(window_sequence, 0, alignment_window_end - alignment_window_start, clipped_sequence, seed_length, candidate_positions);
+
 	for (int contig_pos = alignment_window_start; contig_pos <= alignment_window_end; ++contig_pos) {
 
+		if (seeded && !candidate_positions[contig_pos - alignment_window_start])
+			continue; // the alignment cannot satisfy the criteria
+
 		// align at given position and abort when too many mismatches have been encountered
 		unsigned int matches = 0;
 		unsigned int mismatches = 0;
@@ -271,7 +664,7 @@ bool is_tandem_duplication(const bam1_t* bam_record, const assembly_t& assembly,
 		tandem_alignment.end = -1;
 		for (unsigned int i = 0; i < clipped_sequence_length && mismatches <= max_mismatches; i++) {
 			int read_pos = (alignment_direction == +1) ? i : clipped_sequence_length - 1 - i;
-			if (contig_sequence[contig_pos+read_pos] == clipped_sequence[read_pos]) {
+			if (window_sequence[contig_pos - alignment_window_start + read_pos] == clipped_sequence[read_pos]) {
 				matches++;
 				if (contig_pos + read_pos < tandem_alignment.start)
 					tandem_alignment.start = contig_pos + read_pos;
@@ -291,9 +684,7 @@ bool is_tandem_duplication(const bam1_t* bam_record, const assembly_t& assembly,
 			                                 clipped_start  && get_strand(bam_record) == FORWARD ||
 			                                 !clipped_start && get_strand(bam_record) == REVERSE;
 			if (!tandem_alignment.supplementary) { // only keep sequence in memory, if this is not the supplementary alignment (because then it's already stored in the split-read)
-				tandem_alignment.sequence.resize(bam_record->core.l_qseq);
-				for (int i = 0; i < bam_record->core.l_qseq; ++i)
-					tandem_alignment.sequence[i] = seq_nt16_str[bam_seqi(bam_get_seq(bam_record), i)];
+				tandem_alignment.sequence.assign(bam_get_seq(bam_record), bam_record->core.l_qseq);
 			}
 			// construct CIGAR string
 			uint32_t clip_left = (clipped_start) ? 0 : bam_record->core.l_qseq - clipped_sequence_length;
@@ -319,7 +710,8 @@ bool is_tandem_duplication(const bam1_t* bam_record, const assembly_t& assembly,
 unsigned int remove_malformed_alignments(chimeric_alignments_t& chimeric_alignments) {
 
 	unsigned int malformed_count = 0;
-	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end();) {
+	chimeric_alignments_t::iterator kept_chimeric_alignment = chimeric_alignments.begin(); // well-formed reads are moved to the front
+	for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment) {
 
 		bool malformed = false;
 
@@ -432,11 +824,13 @@ unsigned int remove_malformed_alignments(chimeric_alignments_t& chimeric_alignme
 
 		if (malformed) {
 			malformed_count++;
-			chimeric_alignment = chimeric_alignments.erase(chimeric_alignment);
 		} else {
-			++chimeric_alignment;
+			if (kept_chimeric_alignment != chimeric_alignment)
+				*kept_chimeric_alignment = move(*chimeric_alignment);
+			++kept_chimeric_alignment;
 		}
 	}
+	chimeric_alignments.erase(kept_chimeric_alignment, chimeric_alignments.end());
 
 	return malformed_count;
 }
@@ -457,13 +851,284 @@ bool is_clipped_at_correct_end(const bam1_t* bam_record) {
 	return clipped_cigar == BAM_CSOFT_CLIP || clipped_cigar == BAM_CHARD_CLIP;
 }
 
-unsigned int read_chimeric_alignments(const string& bam_file_path, const assembly_t& assembly, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, vector<unsigned long int>& mapped_viral_reads_by_contig, coverage_t& coverage, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs, const string& viral_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const bool external_duplicate_marking, const unsigned int max_itd_length) {
+// extract chimeric reads from BAM records
+// the extractor is shared by all threads, each of which keeps its state in a bam_record_shard_t
+class chimeric_alignment_extractor_t {
+	public:
+		chimeric_alignment_extractor_t(const assembly_t& assembly, const tid_to_contig_t& tid_to_contig, const vector<bool>& interesting_tids, const vector<bool>& viral_contigs_bool, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const bool external_duplicate_marking, const unsigned int max_itd_length):
+			assembly(assembly), tid_to_contig(tid_to_contig), interesting_tids(interesting_tids), viral_contigs_bool(viral_contigs_bool), gene_annotation_index(gene_annotation_index), separate_chimeric_bam_file(separate_chimeric_bam_file), is_rna_bam_file(is_rna_bam_file), external_duplicate_marking(external_duplicate_marking), max_itd_length(max_itd_length) {
+			make_gene_boundaries(gene_annotation_index, gene_boundaries);
+		};
+		bool process_record(bam_record_shard_t& shard, bam1_t* bam_record); // returns true, if the record was kept in the collated BAM records of the shard
+		void process_mates(bam_record_shard_t& shard, read_name_t& read_name, bam1_t* bam_record, bam1_t* previously_seen_mate, const bool clipped, const bool aux_tags_parsed, uint8_t* sa_tag);
+	private:
+		const assembly_t& assembly;
+		const tid_to_contig_t& tid_to_contig;
+		const vector<bool>& interesting_tids;
+		const vector<bool>& viral_contigs_bool;
+		const gene_annotation_index_t& gene_annotation_index;
+		gene_boundaries_t gene_boundaries;
+		const bool separate_chimeric_bam_file;
+		const bool is_rna_bam_file;
+		const bool external_duplicate_marking;
+		const unsigned int max_itd_length;
+};
+
+// try to insert the mate into the collated BAM records
+// if there was already a record with the same read name, this mate is returned and removed from the collated BAM records
+// otherwise NULL is returned and the given record is kept in the collated BAM records
+bam1_t* collate_mate(bam_record_shard_t& shard, bam1_t* bam_record, read_name_t& read_name) {
+	// the key is made of the read name followed by the binary HI tag to enable segregation of multi-mapping reads
+	// the HI tag is needed even for primary alignments, because STAR flags all best hits as primary with --outSAMprimaryFlag AllBestScore
+	resolve_hit_index(read_name, bam_record);
+	shard.collation_key.assign(bam_get_qname(bam_record), bam_record->core.l_qname - bam_record->core.l_extranul - 1);
+	shard.collation_key.append((const char*) &read_name.hit_index, sizeof(read_name.hit_index));
+	pair<collated_bam_records_t::iterator,bool> find_previously_seen_mate = shard.collated_bam_records.insert_ks(shard.collation_key.data(), shard.collation_key.size(), bam_record);
+	if (find_previously_seen_mate.second)
+		return NULL; // this is the first mate we have seen
+	bam1_t* previously_seen_mate = *find_previously_seen_mate.first;
+	shard.collated_bam_records.erase(find_previously_seen_mate.first);
+	return previously_seen_mate;
+}
 
-	// open BAM file
+bool chimeric_alignment_extractor_t::process_record(bam_record_shard_t& shard, bam1_t* bam_record) {
+
+	if (is_rna_bam_file)
+		if ((bam_record->core.flag & BAM_FUNMAP) || (bam_record->core.flag & BAM_FPAIRED) && (bam_record->core.flag & BAM_FMUNMAP))
+			return false; // ignore unmapped reads
+
+	// most records are unremarkable primary alignments of proper pairs, which we can tell from the core fields alone
+	// => aux tags are only parsed when needed, and then HI and SA are extracted in a single pass
+	bool clipped = is_clipped(bam_record);
+	bool unremarkable = !(bam_record->core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) && (!(bam_record->core.flag & BAM_FPAIRED) || (bam_record->core.flag & BAM_FPROPER_PAIR)) && !clipped;
+	bool aux_tags_parsed = false;
+	uint8_t* hi_tag = NULL;
+	uint8_t* sa_tag = NULL;
+	read_name_t read_name(bam_get_qname(bam_record), 1); // the name is only copied when the read is added to the chimeric alignments
+	if (!separate_chimeric_bam_file) { // ignore HI tag in Chimeric.out.sam, because it only contains unique hits anyway
+		if (unremarkable) {
+			read_name.hit_index = UNKNOWN_HIT_INDEX; // looked up, when mates are collated or the read is stored
+		} else {
+			find_hi_and_sa_tags(bam_record, hi_tag, sa_tag);
+			aux_tags_parsed = true;
+			if (hi_tag != NULL) {
+				read_name.hit_index = bam_aux2i(hi_tag);
+			} else if (bam_record->core.flag & BAM_FSECONDARY) {
+				shard.missing_hi_tag++;
+				return false; // ignore secondary alignments when HI tag is missing, because multi-mapping alignments could not be segregated
+			}
+		}
+	}
+
+	// fix contig number to match ours
+	bam_record->core.tid = tid_to_contig[bam_record->core.tid];
+
+	// add supplementary alignments directly to the chimeric alignments without collating
+	if (separate_chimeric_bam_file && !is_rna_bam_file && (bam_record->core.flag & BAM_FSECONDARY)) { // extract supplementary reads from Chimeric.out.sam
+		add_chimeric_alignment(shard.chimeric_alignments[read_name], bam_record, true/*supplementary*/);
+		shard.no_chimeric_reads = false;
+		return false;
+	}
+
+	// add supplementary alignments directly to the chimeric alignments without collating
+	if (is_rna_bam_file && (bam_record->core.flag & BAM_FSUPPLEMENTARY)) { // extract supplementary reads from Aligned.out.bam
+		if (!separate_chimeric_bam_file) { // don't load alignments twice (from Chimeric.out.sam and from Aligned.out.bam)
+			if (is_clipped_at_correct_end(bam_record))
+				add_chimeric_alignment(shard.chimeric_alignments[read_name], bam_record, true/*supplementary*/);
+			else
+				shard.malformed_count++;
+			shard.no_chimeric_reads = false;
+		}
+		return false;
+	}
+
+	// count mapped reads on interesting contigs
+	if (interesting_tids[bam_record->core.tid])
+		shard.mapped_reads++;
+
+	// add discordant mates directly to the chimeric alignments without collating
+	if (is_rna_bam_file && (bam_record->core.flag & BAM_FPAIRED) && !(bam_record->core.flag & BAM_FPROPER_PAIR)) { // extract discordant mates from Aligned.out.bam
+		if (!separate_chimeric_bam_file) { // don't load alignments twice (from Chimeric.out.sam and from Aligned.out.bam)
+			add_chimeric_alignment(shard.chimeric_alignments[read_name], bam_record);
+			shard.no_chimeric_reads = false;
+		}
+		// compute coverage of discordant mates individually as if they were single-end reads
+		if (!external_duplicate_marking || !(bam_record->core.flag & BAM_FDUP)) {
+			bam_record->core.flag &= !BAM_FPAIRED;
+			shard.coverage.add_fragment(bam_record, NULL, true);
+		}
+		return false;
+	}
+
+	// for paired-end data we need to wait until we have read both mates
+	bam1_t* previously_seen_mate = NULL;
+	if (bam_record->core.flag & BAM_FPAIRED) {
+		previously_seen_mate = collate_mate(shard, bam_record, read_name);
+		if (previously_seen_mate == NULL)
+			return true; // this is the first mate with the given read name, which we encounter => keep it until we have found the second mate
+	}
+
+	// single-end data or we have already read the first mate previously
+	process_mates(shard, read_name, bam_record, previously_seen_mate, clipped, aux_tags_parsed, sa_tag);
+	if (previously_seen_mate != NULL)
+		shard.recycled_bam_records.push_back(previously_seen_mate);
+	return false;
+}
+
+void chimeric_alignment_extractor_t::process_mates(bam_record_shard_t& shard, read_name_t& read_name, bam1_t* bam_record, bam1_t* previously_seen_mate, const bool clipped, const bool aux_tags_parsed, uint8_t* sa_tag) {
+
+	if (separate_chimeric_bam_file && !is_rna_bam_file) { // this is Chimeric.out.sam => load everything
+
+		mates_t& mates = shard.chimeric_alignments[read_name];
+		add_chimeric_alignment(mates, bam_record);
+		if (previously_seen_mate != NULL)
+			add_chimeric_alignment(mates, previously_seen_mate);
+		shard.no_chimeric_reads = false;
+
+	} else { // this is Aligned.out.bam => load only discordant mates and split reads, and only when there is no Chimeric.out.sam
+
+		bool is_read_through_alignment = false;
+		alignment_t tandem_alignment;
+
+		// only clipped records can have an SA tag
+		uint8_t* hi_tag = NULL;
+		if (clipped && !aux_tags_parsed)
+			find_hi_and_sa_tags(bam_record, hi_tag, sa_tag);
+		uint8_t* mate_hi_tag = NULL;
+		uint8_t* mate_sa_tag = NULL;
+		if (previously_seen_mate != NULL && is_clipped(previously_seen_mate))
+			find_hi_and_sa_tags(previously_seen_mate, mate_hi_tag, mate_sa_tag);
+
+		if (sa_tag != NULL && is_clipped_at_correct_end(bam_record) ||
+		    mate_sa_tag != NULL && is_clipped_at_correct_end(previously_seen_mate)) { // split-read with SA tag
+			if (!separate_chimeric_bam_file) {
+				resolve_hit_index(read_name, bam_record);
+				mates_t& mates = shard.chimeric_alignments[read_name];
+				add_chimeric_alignment(mates, bam_record);
+				if (previously_seen_mate != NULL)
+					add_chimeric_alignment(mates, previously_seen_mate);
+				shard.no_chimeric_reads = false;
+			}
+		} else if (!clipped_sequence_is_adapter(bam_record, previously_seen_mate) &&
+		           (previously_seen_mate == NULL || get_strand(bam_record) != get_strand(previously_seen_mate)) && // strands must be different, so we can distinguish mate1 from mate2
+		           (is_tandem_duplication(bam_record, assembly, max_itd_length, tandem_alignment) || // is it a tandem duplication that STAR failed to align?
+		            is_tandem_duplication(previously_seen_mate, assembly, max_itd_length, tandem_alignment))) {
+			resolve_hit_index(read_name, bam_record);
+			if (!separate_chimeric_bam_file || is_rna_bam_file && shard.chimeric_alignments.find(read_name) == shard.chimeric_alignments.end()) {
+				mates_t& mates = shard.chimeric_alignments[read_name];
+				add_chimeric_alignment(mates, bam_record, get_strand(bam_record) == tandem_alignment.strand && !tandem_alignment.supplementary);
+				if (previously_seen_mate != NULL)
+					add_chimeric_alignment(mates, previously_seen_mate, get_strand(previously_seen_mate) == tandem_alignment.strand && !tandem_alignment.supplementary);
+				mates.push_back(tandem_alignment);
+			}
+		} else { // could be a read-through alignment
+			is_read_through_alignment = extract_read_through_alignment(shard.chimeric_alignments, read_name, bam_record, previously_seen_mate, gene_annotation_index, gene_boundaries);
+
+			// count mapped reads on viral contigs to detect viral infection
+			if (viral_contigs_bool[bam_record->core.tid]) {
+				// only count perfectly matching alignments to ignore alignment artifacts
+				for (bam1_t* mate = bam_record; mate != NULL; mate = (mate == previously_seen_mate) ? NULL : previously_seen_mate) {
+					bool pristine_alignment = true;
+					for (unsigned int i = 0; i < mate->core.n_cigar && pristine_alignment; i++) {
+						uint32_t cigar_op = bam_cigar_op(bam_get_cigar(mate)[i]);
+						if (cigar_op != BAM_CREF_SKIP && cigar_op != BAM_CMATCH && cigar_op != BAM_CDIFF)
+							pristine_alignment = false;
+					}
+					if (pristine_alignment)
+						shard.mapped_viral_reads_by_contig[mate->core.tid]++;
+				}
+			}
+		}
+
+		if (!external_duplicate_marking || !(bam_record->core.flag & BAM_FDUP)) {
+			shard.coverage.add_fragment(bam_record, previously_seen_mate, is_read_through_alignment);
+		}
+	}
+}
+
+// extract chimeric reads from the records of one shard
+void extract_chimeric_alignments_from_shard(bam_record_reader_t& bam_record_reader, bam_record_shard_t& shard, chimeric_alignment_extractor_t& extractor) {
+	bam1_t* bam_record;
+	while ((bam_record = bam_record_reader.next_record(shard.cursor)) != NULL)
+		if (extractor.process_record(shard, bam_record))
+			bam_record_reader.keep_record(shard.cursor, shard.get_recycled_bam_record()); // replace the record in the batch with a recycled one, whose memory can be reused without reallocation
+}
+
+samFile* open_bam_file(const string& bam_file_path, const string& assembly_file_path, htsThreadPool& thread_pool) {
 	samFile* bam_file = sam_open(bam_file_path.c_str(), "rb");
 	crash(bam_file == NULL, "failed to open SAM file");
-	if (bam_file->is_cram)
+	if (thread_pool.pool != NULL)
+		hts_set_opt(bam_file, HTS_OPT_THREAD_POOL, &thread_pool); // decompress in parallel (failure is not fatal, since not all formats support multi-threading)
+	if (bam_file->is_cram) {
 		cram_set_option(bam_file->fp.cram, CRAM_OPT_REFERENCE, assembly_file_path.c_str());
+		// only decode the fields we need, most notably skip the decoding of qualities
+		cram_set_option(bam_file->fp.cram, CRAM_OPT_REQUIRED_FIELDS, SAM_QNAME | SAM_FLAG | SAM_RNAME | SAM_POS | SAM_CIGAR | SAM_SEQ | SAM_AUX);
+		cram_set_option(bam_file->fp.cram, CRAM_OPT_DECODE_MD, 0); // we don't need the MD and NM tags, so don't compute them from the reference
+	}
+	return bam_file;
+}
+
+// extract chimeric reads from the regions of an indexed BAM file, which are not yet processed by another thread
+void extract_chimeric_alignments_from_regions(const string& bam_file_path, const string& assembly_file_path, htsThreadPool& thread_pool, vector<bam_record_region_t>& regions, atomic<unsigned int>& next_region, bam_record_shard_t& shard, chimeric_alignment_extractor_t& extractor) {
+
+	// every thread needs its own file handle
+	samFile* bam_file = open_bam_file(bam_file_path, assembly_file_path, thread_pool);
+	bam_hdr_t* bam_header = sam_hdr_read(bam_file);
+	crash(bam_header == NULL, "failed to read SAM header");
+	hts_idx_t* bam_index = sam_index_load(bam_file, bam_file_path.c_str());
+	crash(bam_index == NULL, "failed to load index of SAM file");
+
+	bam1_t* bam_record = bam_init1();
+	crash(bam_record == NULL, "failed to allocate memory");
+	for (unsigned int region = next_region++; region < regions.size(); region = next_region++) {
+
+		hts_itr_t* bam_iterator = sam_itr_queryi(bam_index, region, 0, HTS_POS_MAX);
+		crash(bam_iterator == NULL, "failed to query region of SAM file");
+		int sam_itr_next_status;
+		while ((sam_itr_next_status = sam_itr_next(bam_file, bam_iterator, bam_record)) >= 0) {
+			if (extractor.process_record(shard, bam_record)) { // the record is kept in the collated BAM records => we need a new one
+				bam_record = shard.get_recycled_bam_record();
+				if (bam_record == NULL) {
+					bam_record = bam_init1();
+					crash(bam_record == NULL, "failed to allocate memory");
+				}
+			}
+		}
+		crash(sam_itr_next_status < -1, "failed to load alignments");
+		hts_itr_destroy(bam_iterator);
+
+		// hand over the results of this region, so they can be merged in the order of the regions
+		regions[region].chimeric_alignments.swap(shard.chimeric_alignments);
+		for (collated_bam_records_t::iterator unpaired_mate = shard.collated_bam_records.begin(); unpaired_mate != shard.collated_bam_records.end(); ++unpaired_mate)
+			regions[region].unpaired_mates.push_back(*unpaired_mate);
+		shard.collated_bam_records.clear();
+	}
+
+	bam_destroy1(bam_record);
+	hts_idx_destroy(bam_index);
+	bam_hdr_destroy(bam_header);
+	sam_close(bam_file);
+}
+
+// add the chimeric alignments of a region to those of the preceding regions
+void merge_chimeric_alignments_of_region(chimeric_alignments_t& chimeric_alignments, chimeric_alignments_t& region_chimeric_alignments, const bool separate_chimeric_bam_file) {
+	for (chimeric_alignments_t::iterator region_chimeric_alignment = region_chimeric_alignments.begin(); region_chimeric_alignment != region_chimeric_alignments.end(); ++region_chimeric_alignment) {
+		pair<chimeric_alignments_t::iterator,bool> chimeric_alignment = chimeric_alignments.insert(region_chimeric_alignment->first);
+		if (chimeric_alignment.second) {
+			chimeric_alignment.first->second = move(region_chimeric_alignment->second);
+		} else if (!separate_chimeric_bam_file) { // the read was loaded from another region => append the alignments as if the file had been read sequentially
+			mates_t& mates = chimeric_alignment.first->second;
+			mates.duplicate = mates.duplicate || region_chimeric_alignment->second.duplicate;
+			mates.insert(mates.end(), region_chimeric_alignment->second.begin(), region_chimeric_alignment->second.end());
+		} // else the read was loaded from Chimeric.out.sam already
+	}
+	region_chimeric_alignments.clear();
+}
+
+unsigned int read_chimeric_alignments(const string& bam_file_path, const assembly_t& assembly, const string& assembly_file_path, chimeric_alignments_t& chimeric_alignments, unsigned long int& mapped_reads, vector<unsigned long int>& mapped_viral_reads_by_contig, coverage_t& coverage, contigs_t& contigs, vector<string>& original_contig_names, const string& interesting_contigs, const string& viral_contigs, const gene_annotation_index_t& gene_annotation_index, const bool separate_chimeric_bam_file, const bool is_rna_bam_file, const bool external_duplicate_marking, const unsigned int max_itd_length, const unsigned int threads, htsThreadPool& thread_pool) {
+
+	// open BAM file
+	samFile* bam_file = open_bam_file(bam_file_path, assembly_file_path, thread_pool);
 	bam_hdr_t* bam_header = sam_hdr_read(bam_file);
 	crash(bam_header == NULL, "failed to read SAM header");
 
@@ -489,7 +1154,7 @@ unsigned int read_chimeric_alignments(const string& bam_file_path, const assembl
 
 	// make sure we have the sequence of all interesting contigs, otherwise later steps will crash
 	for (contigs_t::iterator contig = contigs.begin(); contig != contigs.end(); ++contig)
-		crash(assembly.find(contig->second) == assembly.end() && is_interesting_contig(contig->first, interesting_contigs), "could not find sequence of contig '" + contig->first + "'");
+		crash(!assembly.count(contig->second) && is_interesting_contig(contig->first, interesting_contigs), "could not find sequence of contig '" + contig->first + "'");
 
 	// convert viral contigs to vector of booleans for faster lookup
 	vector<bool> viral_contigs_bool(contigs.size());
@@ -498,165 +1163,118 @@ unsigned int read_chimeric_alignments(const string& bam_file_path, const assembl
 	mapped_viral_reads_by_contig.resize(contigs.size());
 
 	// read BAM records
-	bam1_t* bam_record = bam_init1();
-	crash(bam_record == NULL, "failed to allocate memory.");
-	collated_bam_records_t collated_bam_records; // holds the first mate until we have found the second
-	bool no_chimeric_reads = true;
-	unsigned int missing_hi_tag = 0;
-	unsigned int malformed_count = 0;
-	string read_name;
-	int sam_read1_status;
-	while ((sam_read1_status = sam_read1(bam_file, bam_header, bam_record)) >= 0) {
-
-		if (is_rna_bam_file)
-			if ((bam_record->core.flag & BAM_FUNMAP) || (bam_record->core.flag & BAM_FPAIRED) && (bam_record->core.flag & BAM_FMUNMAP))
-				continue; // ignore unmapped reads
-
-		int64_t hit_index = 1;
-		if (!separate_chimeric_bam_file) { // ignore HI tag in Chimeric.out.sam, because it only contains unique hits anyway
-			uint8_t* hi_tag = bam_aux_get(bam_record, "HI");
-			if (hi_tag != NULL) {
-				hit_index = bam_aux2i(hi_tag);
-			} else if (bam_record->core.flag & BAM_FSECONDARY) {
-				missing_hi_tag++;
-				continue; // ignore secondary alignments when HI tag is missing, because multi-mapping alignments could not be segregated
-			}
-		}
-		read_name = (char*) bam_get_qname(bam_record);
-		read_name += "," + to_string(hit_index); // append HI tag to name to enable segregation of multi-mapping reads
-
-		// fix contig number to match ours
-		bam_record->core.tid = tid_to_contig[bam_record->core.tid];
+	// when multi-threading is enabled, each thread extracts chimeric reads from a subset of the records
+	chimeric_alignment_extractor_t extractor(assembly, tid_to_contig, interesting_tids, viral_contigs_bool, gene_annotation_index, separate_chimeric_bam_file, is_rna_bam_file, external_duplicate_marking, max_itd_length);
+	vector<bam_record_shard_t> shards((thread_pool.pool != NULL) ? threads : 1); // multiple shards require asynchronous decompression
+	for (unsigned int shard = 0; shard < shards.size(); ++shard) {
+		bam_record_cursor_t cursor = { shard, 0, NULL, 0 };
+		shards[shard].cursor = cursor;
+		shards[shard].mapped_viral_reads_by_contig.resize(contigs.size());
+		if (shard == 0)
+			shards[shard].coverage.swap(coverage); // the first shard continues with the coverage of previous input files
+		else
+			shards[shard].coverage.resize(shards[0].coverage);
+	}
 
-		// add supplementary alignments directly to the chimeric alignments without collating
-		if (separate_chimeric_bam_file && !is_rna_bam_file && (bam_record->core.flag & BAM_FSECONDARY)) { // extract supplementary reads from Chimeric.out.sam
-			add_chimeric_alignment(chimeric_alignments[read_name], bam_record, true/*supplementary*/);
-			no_chimeric_reads = false;
-			continue;
+	// indexed (i.e., coordinate-sorted) BAM files can be read by region in parallel
+	bool read_by_region = false;
+	if (shards.size() > 1 && is_rna_bam_file) {
+		hts_idx_t* bam_index = sam_index_load(bam_file, bam_file_path.c_str());
+		if (bam_index != NULL) {
+			read_by_region = true;
+			hts_idx_destroy(bam_index);
 		}
+	}
 
-		// add supplementary alignments directly to the chimeric alignments without collating
-		if (is_rna_bam_file && (bam_record->core.flag & BAM_FSUPPLEMENTARY)) { // extract supplementary reads from Aligned.out.bam
-			if (!separate_chimeric_bam_file) { // don't load alignments twice (from Chimeric.out.sam and from Aligned.out.bam)
-				if (is_clipped_at_correct_end(bam_record))
-					add_chimeric_alignment(chimeric_alignments[read_name], bam_record, true/*supplementary*/);
-				else
-					malformed_count++;
-				no_chimeric_reads = false;
+	if (read_by_region) { // each thread reads one contig at a time
+
+		vector<bam_record_region_t> regions(bam_header->n_targets);
+		atomic<unsigned int> next_region(0);
+		vector<thread> workers;
+		for (unsigned int shard = 0; shard < shards.size(); ++shard)
+			workers.push_back(thread(extract_chimeric_alignments_from_regions, cref(bam_file_path), cref(assembly_file_path), ref(thread_pool), ref(regions), ref(next_region), ref(shards[shard]), ref(extractor)));
+		for (auto worker = workers.begin(); worker != workers.end(); ++worker)
+			worker->join();
+
+		// merge the regions in the order of the file, such that the result is the same as when the file is read sequentially
+		for (auto region = regions.begin(); region != regions.end(); ++region)
+			merge_chimeric_alignments_of_region(chimeric_alignments, region->chimeric_alignments, separate_chimeric_bam_file);
+
+		// pair mates which are located in different regions
+		for (auto region = regions.begin(); region != regions.end(); ++region) {
+			for (auto unpaired_mate = region->unpaired_mates.begin(); unpaired_mate != region->unpaired_mates.end(); ++unpaired_mate) {
+				read_name_t read_name(bam_get_qname(*unpaired_mate), 1);
+				if (!separate_chimeric_bam_file)
+					read_name.hit_index = UNKNOWN_HIT_INDEX; // looked up when collating
+				bam1_t* previously_seen_mate = collate_mate(shards[0], *unpaired_mate, read_name);
+				if (previously_seen_mate != NULL) {
+					extractor.process_mates(shards[0], read_name, *unpaired_mate, previously_seen_mate, is_clipped(*unpaired_mate), false, NULL);
+					shards[0].recycled_bam_records.push_back(previously_seen_mate);
+					shards[0].recycled_bam_records.push_back(*unpaired_mate);
+				}
 			}
-			continue;
 		}
+		merge_chimeric_alignments_of_region(chimeric_alignments, shards[0].chimeric_alignments, separate_chimeric_bam_file);
 
-		// count mapped reads on interesting contigs
-		if (interesting_tids[bam_record->core.tid])
-			mapped_reads++;
+	} else { // records are decoded by a separate thread and each thread processes a shard of records as given by the hash of the read name
 
-		// add discordant mates directly to the chimeric alignments without collating
-		if (is_rna_bam_file && (bam_record->core.flag & BAM_FPAIRED) && !(bam_record->core.flag & BAM_FPROPER_PAIR)) { // extract discordant mates from Aligned.out.bam
-			if (!separate_chimeric_bam_file) { // don't load alignments twice (from Chimeric.out.sam and from Aligned.out.bam)
-				add_chimeric_alignment(chimeric_alignments[read_name], bam_record);
-				no_chimeric_reads = false;
-			}
-			// compute coverage of discordant mates individually as if they were single-end reads
-			if (!external_duplicate_marking || !(bam_record->core.flag & BAM_FDUP)) {
-				bam_record->core.flag &= !BAM_FPAIRED;
-				coverage.add_fragment(bam_record, NULL, true);
-			}
-			continue;
+		// distribute previously loaded chimeric alignments over the shards, so they are found again when reading the same read names
+		if (shards.size() == 1) {
+			shards[0].chimeric_alignments.swap(chimeric_alignments);
+		} else {
+			for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); chimeric_alignment != chimeric_alignments.end(); ++chimeric_alignment)
+				shards[get_shard(chimeric_alignment->first.name, strlen(chimeric_alignment->first.name), shards.size())].chimeric_alignments[chimeric_alignment->first] = move(chimeric_alignment->second);
+			chimeric_alignments.clear();
 		}
 
-		// for paired-end data we need to wait until we have read both mates
-		bam1_t* previously_seen_mate = NULL;
-		if (bam_record->core.flag & BAM_FPAIRED) {
-
-			// try to insert the mate into the collated BAM records
-			// if there was already a record with the same read name, insertion will fail (->second set to false) and
-			// previously_seen_mate->first will point to the mate which was already in the collated BAM records
-			pair<collated_bam_records_t::iterator,bool> find_previously_seen_mate = collated_bam_records.insert(read_name.c_str(), bam_record);
-			if (!find_previously_seen_mate.second) { // this is the second mate we have seen
-				previously_seen_mate = *find_previously_seen_mate.first;
-				collated_bam_records.erase(find_previously_seen_mate.first);
-			}
-
+		bam_record_reader_t bam_record_reader(bam_file, bam_header, thread_pool.pool != NULL, shards.size());
+		if (shards.size() == 1) {
+			extract_chimeric_alignments_from_shard(bam_record_reader, shards[0], extractor);
+		} else {
+			vector<thread> workers;
+			for (unsigned int shard = 0; shard < shards.size(); ++shard)
+				workers.push_back(thread(extract_chimeric_alignments_from_shard, ref(bam_record_reader), ref(shards[shard]), ref(extractor)));
+			for (auto worker = workers.begin(); worker != workers.end(); ++worker)
+				worker->join();
 		}
+		crash(bam_record_reader.status < -1, "failed to load alignments");
 
-		if ((bam_record->core.flag & BAM_FPAIRED) && previously_seen_mate == NULL) { // this is the first mate with the given read name, which we encounter
-			
-			bam_record = bam_init1(); // allocate memory for the next record
-			crash(bam_record == NULL, "failed to allocate memory");
-
-		} else { // single-end data or we have already read the first mate previously
-
-			if (separate_chimeric_bam_file && !is_rna_bam_file) { // this is Chimeric.out.sam => load everything
-
-				mates_t& mates = chimeric_alignments[read_name];
-				add_chimeric_alignment(mates, bam_record);
-				if (previously_seen_mate != NULL)
-					add_chimeric_alignment(mates, previously_seen_mate);
-				no_chimeric_reads = false;
-
-			} else { // this is Aligned.out.bam => load only discordant mates and split reads, and only when there is no Chimeric.out.sam
-
-				bool is_read_through_alignment = false;
-				alignment_t tandem_alignment;
-
-				if (bam_aux_get(bam_record, "SA") != NULL && is_clipped_at_correct_end(bam_record) ||
-				    previously_seen_mate != NULL && bam_aux_get(previously_seen_mate, "SA") != NULL && is_clipped_at_correct_end(previously_seen_mate)) { // split-read with SA tag
-					if (!separate_chimeric_bam_file) {
-						mates_t& mates = chimeric_alignments[read_name];
-						add_chimeric_alignment(mates, bam_record);
-						if (previously_seen_mate != NULL)
-							add_chimeric_alignment(mates, previously_seen_mate);
-						no_chimeric_reads = false;
-					}
-				} else if (!clipped_sequence_is_adapter(bam_record, previously_seen_mate) &&
-				           (previously_seen_mate == NULL || get_strand(bam_record) != get_strand(previously_seen_mate)) && // strands must be different, so we can distinguish mate1 from mate2
-				           (is_tandem_duplication(bam_record, assembly, max_itd_length, tandem_alignment) || // is it a tandem duplication that STAR failed to align?
-				            is_tandem_duplication(previously_seen_mate, assembly, max_itd_length, tandem_alignment))) {
-					if (!separate_chimeric_bam_file || is_rna_bam_file && chimeric_alignments.find(read_name) == chimeric_alignments.end()) {
-						mates_t& mates = chimeric_alignments[read_name];
-						add_chimeric_alignment(mates, bam_record, get_strand(bam_record) == tandem_alignment.strand && !tandem_alignment.supplementary);
-						if (previously_seen_mate != NULL)
-							add_chimeric_alignment(mates, previously_seen_mate, get_strand(previously_seen_mate) == tandem_alignment.strand && !tandem_alignment.supplementary);
-						mates.push_back(tandem_alignment);
-					}
-				} else { // could be a read-through alignment
-					is_read_through_alignment = extract_read_through_alignment(chimeric_alignments, read_name, bam_record, previously_seen_mate, gene_annotation_index, separate_chimeric_bam_file);
-
-					// count mapped reads on viral contigs to detect viral infection
-					if (viral_contigs_bool[bam_record->core.tid]) {
-						// only count perfectly matching alignments to ignore alignment artifacts
-						for (bam1_t* mate = bam_record; mate != NULL; mate = (mate == previously_seen_mate) ? NULL : previously_seen_mate) {
-							bool pristine_alignment = true;
-							for (unsigned int i = 0; i < mate->core.n_cigar && pristine_alignment; i++) {
-								uint32_t cigar_op = bam_cigar_op(bam_get_cigar(mate)[i]);
-								if (cigar_op != BAM_CREF_SKIP && cigar_op != BAM_CMATCH && cigar_op != BAM_CDIFF)
-									pristine_alignment = false;
-							}
-							if (pristine_alignment)
-								mapped_viral_reads_by_contig[mate->core.tid]++;
-						}
-					}
-				}
-
-				if (!external_duplicate_marking || !(bam_record->core.flag & BAM_FDUP))
-					coverage.add_fragment(bam_record, previously_seen_mate, is_read_through_alignment);
-			}
-
-			if (previously_seen_mate != NULL)
-				bam_destroy1(previously_seen_mate);
+		for (auto shard = shards.begin(); shard != shards.end(); ++shard) {
+			if (shards.size() == 1)
+				chimeric_alignments.swap(shard->chimeric_alignments);
+			else
+				chimeric_alignments.merge(shard->chimeric_alignments);
 		}
 	}
 
-	crash(sam_read1_status < -1, "failed to load alignments");
+	// merge read counts of all shards
+	bool no_chimeric_reads = true;
+	unsigned int missing_hi_tag = 0;
+	unsigned int malformed_count = 0;
+	coverage.swap(shards[0].coverage);
+	for (auto shard = shards.begin(); shard != shards.end(); ++shard) {
+		if (shard != shards.begin())
+			coverage.merge(shard->coverage);
+		mapped_reads += shard->mapped_reads;
+		for (unsigned int contig = 0; contig < mapped_viral_reads_by_contig.size(); ++contig)
+			mapped_viral_reads_by_contig[contig] += shard->mapped_viral_reads_by_contig[contig];
+		no_chimeric_reads = no_chimeric_reads && shard->no_chimeric_reads;
+		missing_hi_tag += shard->missing_hi_tag;
+		malformed_count += shard->malformed_count;
+		for (auto bam_record = shard->recycled_bam_records.begin(); bam_record != shard->recycled_bam_records.end(); ++bam_record)
+			bam_destroy1(*bam_record);
+		for (collated_bam_records_t::iterator bam_record = shard->collated_bam_records.begin(); bam_record != shard->collated_bam_records.end(); ++bam_record)
+			bam_destroy1(*bam_record); // mates whose partner was never seen
+	}
 
 	// close BAM file
-	bam_destroy1(bam_record);
 	bam_hdr_destroy(bam_header);
 	sam_close(bam_file);
 
 	// sanity check: input files should not be empty
 	crash(is_rna_bam_file && mapped_reads == 0, "no normal reads found");
+	// group alignments by read name
+	chimeric_alignments.sort();
 	// sanity check: remove malformed alignments
 	malformed_count += remove_malformed_alignments(chimeric_alignments);
 	if (malformed_count > 0)
@@ -693,7 +1311,7 @@ unsigned int mark_multimappers(chimeric_alignments_t& chimeric_alignments) {
 	unsigned int count = 0;
 	if (!chimeric_alignments.empty())
 		for (chimeric_alignments_t::iterator chimeric_alignment = chimeric_alignments.begin(); next(chimeric_alignment) != chimeric_alignments.end(); ++chimeric_alignment)
-			if (strip_hi_tag_from_read_name(chimeric_alignment->first) == strip_hi_tag_from_read_name(next(chimeric_alignment)->first)) {
+			if (chimeric_alignment->first.name == next(chimeric_alignment)->first.name) { // names are interned, so it suffices to compare pointers
 				chimeric_alignment->second.multimapper = true;
 				next(chimeric_alignment)->second.multimapper = true;
 				count++;
@@ -1,3 +1,4 @@
+#include <cstring>
 #include <string>
 #include <iostream>
 #include "bgzf.h"
@@ -62,27 +63,42 @@ bool autodecompress_file_t::getline(string& line) {
 	return true;
 }
 
-tsv_stream_t& tsv_stream_t::operator>>(string& out) {
+// reading beyond the last field sets the failbit
+// (older versions started over at the first field, so callers must check fail() when a line has too few fields)
+tsv_stream_t& tsv_stream_t::operator>>(string_view_t& out) {
 	if (position >= data->size()) {
 		failbit = true;
 	} else {
 		size_t start_position = position;
 		position = data->find(delimiter, start_position);
-		out = data->substr(start_position, position - start_position);
+		if (position > data->size())
+			position = data->size();
+		out = string_view_t(data->data() + start_position, position - start_position);
 		position++; // skip delimiter
 	}
 	return *this;
 }
 
+tsv_stream_t& tsv_stream_t::operator>>(string& out) {
+	string_view_t field;
+	if (!(*this >> field).fail())
+		out.assign(field.data, field.size); // reuses the capacity of out
+	return *this;
+}
+
 tsv_stream_t& tsv_stream_t::operator>>(int& out) {
-	if (position >= data->size()) {
-		failbit = true;
-	} else {
-		size_t start_position = position;
-		position = data->find(delimiter, start_position);
-		if (!str_to_int(data->substr(start_position, position - start_position).c_str(), out))
+	string_view_t field;
+	if (!(*this >> field).fail()) {
+		// copy the field to the stack, because strtol needs a null-terminated string
+		char buffer[32];
+		if (field.size >= sizeof(buffer)) {
 			failbit = true;
-		position++; // skip delimiter
+		} else {
+			memcpy(buffer, field.data, field.size);
+			buffer[field.size] = '\0';
+			if (!str_to_int(buffer, out))
+				failbit = true;
+		}
 	}
 	return *this;
 }
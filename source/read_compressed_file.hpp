@@ -18,10 +18,25 @@ class autodecompress_file_t {
 		string file_path;
 };
 
+// a field of a line, which references the line buffer rather than copying it
+// (only valid as long as the line is neither modified nor destroyed)
+struct string_view_t {
+	const char* data;
+	size_t size;
+	string_view_t(): data(NULL), size(0) {};
+	string_view_t(const char* d, const size_t s): data(d), size(s) {};
+	bool empty() const { return size == 0; };
+	char operator[](const size_t i) const { return data[i]; };
+	string str() const { return string(data, size); };
+};
+inline bool operator==(const string& s, const string_view_t& v) { return s.size() == v.size && s.compare(0, string::npos, v.data, v.size) == 0; }
+inline string& operator+=(string& s, const string_view_t& v) { return s.append(v.data, v.size); }
+
 class tsv_stream_t {
 	public:
 		tsv_stream_t(const string& s, const char d='\t'): data(&s), delimiter(d), position(0), failbit(false) {};
 		tsv_stream_t& operator>>(string& out);
+		tsv_stream_t& operator>>(string_view_t& out);
 		tsv_stream_t& operator>>(int& out);
 		bool fail() const { return failbit; };
 	private:
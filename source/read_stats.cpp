@@ -1,5 +1,7 @@
 #include <climits>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <list>
 #include <vector>
@@ -135,17 +137,40 @@ strandedness_t detect_strandedness(const chimeric_alignments_t& chimeric_alignme
 		return STRANDEDNESS_NO; // not enough signal => assume no
 }
 
-// initialize data structure to compute coverage for windows of size <COVERAGE_RESOLUTION>
+// initialize data structure to compute coverage for windows of size <resolution>
+// blocks are allocated lazily by add_fragment()
 void coverage_t::resize(const contigs_t& contigs, const assembly_t& assembly) {
-	fragment_starts.resize(contigs.size());
-	fragment_ends.resize(contigs.size());
-	coverage.resize(contigs.size());
-	for (assembly_t::const_iterator contig = assembly.begin(); contig != assembly.end(); ++contig) {
-		if (!contig->second.empty()) {
-			unsigned int windows = contig->second.size() / COVERAGE_RESOLUTION + 2; //+2 to avoid array-out-of-bounds errors
-			fragment_starts[contig->first].resize(windows);
-			fragment_ends[contig->first].resize(windows);
-			coverage[contig->first].resize(windows);
+	windows.resize(contigs.size());
+	blocks.resize(contigs.size());
+	for (contigs_t::const_iterator contig = contigs.begin(); contig != contigs.end(); ++contig) {
+		if (assembly.length(contig->second) > 0) {
+			windows[contig->second] = assembly.length(contig->second) / resolution + 2; //+2 to avoid array-out-of-bounds errors
+			blocks[contig->second].resize((windows[contig->second] + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		}
+	}
+}
+
+void coverage_t::resize(const coverage_t& other) {
+	resolution = other.resolution;
+	windows = other.windows;
+	blocks.resize(other.blocks.size());
+	for (unsigned int contig = 0; contig < blocks.size(); ++contig)
+		blocks[contig].resize(other.blocks[contig].size());
+}
+
+// the result is the same as if all fragments had been added to one object,
+// because counters saturate at the same value whether they are summed up before or after saturation
+void coverage_t::merge(const coverage_t& other) {
+	for (unsigned int contig = 0; contig < other.blocks.size(); ++contig) {
+		for (unsigned int block = 0; block < other.blocks[contig].size(); ++block) {
+			if (other.blocks[contig][block]) {
+				const block_t& other_block = *other.blocks[contig][block];
+				block_t& this_block = get_block(contig, block * BLOCK_SIZE);
+				for (unsigned int window = 0; window < BLOCK_SIZE; ++window)
+					this_block.coverage[window] = min((unsigned int) USHRT_MAX, (unsigned int) this_block.coverage[window] + other_block.coverage[window]);
+				this_block.fragment_starts |= other_block.fragment_starts;
+				this_block.fragment_ends |= other_block.fragment_ends;
+			}
 		}
 	}
 }
@@ -157,8 +182,8 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, bool is_chimeric) {
 	if (mate2 == NULL)
 		mate2 = mate1;
 
-	if ((unsigned int) mate1->core.tid >= fragment_starts.size() || fragment_starts[mate1->core.tid].empty() ||
-	    (unsigned int) mate2->core.tid >= fragment_starts.size() || fragment_starts[mate2->core.tid].empty())
+	if ((unsigned int) mate1->core.tid >= windows.size() || windows[mate1->core.tid] == 0 ||
+	    (unsigned int) mate2->core.tid >= windows.size() || windows[mate2->core.tid] == 0)
 		return; // ignore reads on uninteresting contigs
 
 	if (mate1->core.flag & BAM_FPAIRED) { // paired-end data
@@ -176,17 +201,17 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, bool is_chimeric) {
 
 	// store start of fragment
 	if (!is_chimeric) { // the 'no_coverage' filter should only consider non-chimeric reads
-		if (!(mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED))
-			fragment_starts[mate1->core.tid][mate1->core.pos/COVERAGE_RESOLUTION] = true;
-		else
-			fragment_starts[mate2->core.tid][mate2->core.pos/COVERAGE_RESOLUTION] = true;
+		bam1_t* first_mate = (!(mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED)) ? mate1 : mate2;
+		unsigned int start_window = first_mate->core.pos/resolution;
+		if (start_window < windows[first_mate->core.tid])
+			get_block(first_mate->core.tid, start_window).fragment_starts[start_window % BLOCK_SIZE] = true;
 	}
 
 	// compute coverage from CIGAR string
 	position_t position1 = mate1->core.pos;
 	position_t position2 = mate2->core.pos;
 	position_t position = min(position1, position2);
-	int window = position/COVERAGE_RESOLUTION;
+	int window = position/resolution;
 	unsigned int i1 = 0;
 	unsigned int i2 = 0;
 	while (true) {
@@ -203,14 +228,14 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, bool is_chimeric) {
 			op_length1 = (bam_cigar_type(bam_cigar_op(cigar_op1)) & 2/*consume reference*/) ? bam_cigar_oplen(cigar_op1) : 0;
 		} else { // CIGAR elements of mate1 completely processed
 			op_length1 = 0;
-			window = max(window, position2/COVERAGE_RESOLUTION);
+			window = max(window, position2/resolution);
 		}
 		if (i2 < mate2->core.n_cigar) {
 			cigar_op2 = bam_get_cigar(mate2)[i2];
 			op_length2 = (bam_cigar_type(bam_cigar_op(cigar_op2)) & 2/*consume reference*/) ? bam_cigar_oplen(cigar_op2) : 0;
 		} else { // CIGAR elements of mate2 completely processed
 			op_length2 = 0;
-			window = max(window, position1/COVERAGE_RESOLUTION);
+			window = max(window, position1/resolution);
 		}
 		// pick the mate whose next CIGAR element consumes the least amount of reference
 		contig_t contig;
@@ -237,35 +262,37 @@ void coverage_t::add_fragment(bam1_t* mate1, bam1_t* mate2, bool is_chimeric) {
 
 		// increase coverage counter of windows that CIGAR element overlaps with
 		if (bam_cigar_type(bam_cigar_op(cigar_op)) & 1/*consume query*/) {
-			while (window <= position/COVERAGE_RESOLUTION) {
-				if (coverage[contig][window] < USHRT_MAX)
-					if (position - window * COVERAGE_RESOLUTION >= COVERAGE_RESOLUTION/2) // read must overlap at least half of the window
-						coverage[contig][window]++;
+			while (window <= position/resolution) {
+				if (position - window * resolution >= resolution/2 && (unsigned int) window < windows[contig]) { // read must overlap at least half of the window
+					unsigned short int& window_coverage = get_block(contig, window).coverage[window % BLOCK_SIZE];
+					if (window_coverage < USHRT_MAX)
+						window_coverage++;
+				}
 				++window;
 			}
 		} else {
-			window = position/COVERAGE_RESOLUTION;
+			window = position/resolution;
 		}
 
 	}
 
 	// store end of fragment
 	if (!is_chimeric) { // the 'no_coverage' filter should only consider non-chimeric reads
-		if ((mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED))
-			fragment_ends[mate1->core.tid][(position1-1)/COVERAGE_RESOLUTION] = true;
-		else
-			fragment_ends[mate2->core.tid][(position2-1)/COVERAGE_RESOLUTION] = true;
+		bool is_mate1 = (mate1->core.flag & BAM_FREVERSE) || !(mate1->core.flag & BAM_FPAIRED);
+		contig_t end_contig = (is_mate1 ? mate1 : mate2)->core.tid;
+		unsigned int end_window = ((is_mate1 ? position1 : position2) - 1)/resolution;
+		if (end_window < windows[end_contig])
+			get_block(end_contig, end_window).fragment_ends[end_window % BLOCK_SIZE] = true;
 	}
 }
 
 // returns true, if a fragment begins at the given position
 bool coverage_t::fragment_starts_here(const contig_t contig, const position_t start, const position_t end) const {
-	if ((unsigned int) contig >= fragment_starts.size())
-		return false;
-	for (int window = start/COVERAGE_RESOLUTION + 1; window <= end/COVERAGE_RESOLUTION; ++window) {
-		if ((unsigned int) window >= fragment_starts[contig].size())
+	for (int window = start/resolution + 1; window <= end/resolution; ++window) {
+		if ((unsigned int) window >= get_windows(contig))
 			return false;
-		if (fragment_starts[contig][window])
+		const block_t* block = find_block(contig, window);
+		if (block != NULL && block->fragment_starts[window % BLOCK_SIZE])
 			return true;
 	}
 	return false;
@@ -273,28 +300,172 @@ bool coverage_t::fragment_starts_here(const contig_t contig, const position_t st
 
 // returns true, if a fragment ends at the given position
 bool coverage_t::fragment_ends_here(const contig_t contig, const position_t start, const position_t end) const {
-	if ((unsigned int) contig >= fragment_ends.size())
-		return false;
-	for (int window = start/COVERAGE_RESOLUTION; window < end/COVERAGE_RESOLUTION; ++window) {
-		if ((unsigned int) window >= fragment_ends[contig].size())
+	for (int window = start/resolution; window < end/resolution; ++window) {
+		if ((unsigned int) window >= get_windows(contig))
 			return false;
-		if (fragment_ends[contig][window])
+		const block_t* block = find_block(contig, window);
+		if (block != NULL && block->fragment_ends[window % BLOCK_SIZE])
 			return true;
 	}
 	return false;
 }
 
-// get coverage within a window of <COVERAGE_RESOLUTION> upstream or downstream of given position
+// get coverage within a window of <resolution> upstream or downstream of given position
 int coverage_t::get_coverage(const contig_t contig, const position_t position, const direction_t direction) const {
-	if ((unsigned int) contig >= coverage.size() || coverage[contig].empty())
+	if (get_windows(contig) == 0)
 		return -1;
 	if (direction == UPSTREAM) {
-		if (position < COVERAGE_RESOLUTION)
+		if (position < resolution)
 			return 0;
 		else
-			return coverage[contig][position/COVERAGE_RESOLUTION-1];
+			return get_window_coverage(contig, position/resolution-1);
 	} else { // direction == DOWNSTREAM
-		return coverage[contig][position/COVERAGE_RESOLUTION+1];
+		return get_window_coverage(contig, position/resolution+1);
 	}
 }
 
+
+// the coverage file stores everything Arriba gathers from the main alignments apart from the chimeric reads,
+// such that reruns with different parameters need not read the main alignments again
+const char COVERAGE_FILE_SIGNATURE[] = "ARRIBA_COVERAGE_1";
+
+template <class T> void write_coverage_value(FILE* file, const T* value, const size_t count = 1) {
+	crash(count > 0 && fwrite(value, sizeof(T), count, file) != count, "failed to write coverage file");
+}
+
+template <class T> void read_coverage_value(FILE* file, T* value, const size_t count = 1) {
+	crash(count > 0 && fread(value, sizeof(T), count, file) != count, "failed to read coverage file: file is truncated");
+}
+
+void write_coverage_string(FILE* file, const string& value) {
+	uint32_t length = value.size();
+	write_coverage_value(file, &length);
+	write_coverage_value(file, value.data(), length);
+}
+
+string read_coverage_string(FILE* file) {
+	uint32_t length;
+	read_coverage_value(file, &length);
+	string value(length, '\0');
+	read_coverage_value(file, &value[0], length);
+	return value;
+}
+
+void coverage_t::write_to_file(const string& output_file, const contigs_t& contigs, const vector<string>& original_contig_names, const unsigned long int mapped_reads, const vector<unsigned long int>& mapped_viral_reads_by_contig) const {
+
+	FILE* file = fopen(output_file.c_str(), "wb");
+	crash(file == NULL, "failed to open coverage file for writing: " + output_file);
+
+	write_coverage_value(file, COVERAGE_FILE_SIGNATURE, sizeof(COVERAGE_FILE_SIGNATURE));
+	int32_t resolution = this->resolution;
+	write_coverage_value(file, &resolution);
+	uint64_t reads = mapped_reads;
+	write_coverage_value(file, &reads);
+	uint32_t contig_count = contigs.size();
+	write_coverage_value(file, &contig_count);
+
+	for (contigs_t::const_iterator contig = contigs.begin(); contig != contigs.end(); ++contig) {
+		write_coverage_string(file, contig->first);
+		write_coverage_string(file, (contig->second < original_contig_names.size()) ? original_contig_names[contig->second] : contig->first);
+		uint32_t contig_windows = get_windows(contig->second);
+		write_coverage_value(file, &contig_windows);
+		uint64_t viral_reads = (contig->second < mapped_viral_reads_by_contig.size()) ? mapped_viral_reads_by_contig[contig->second] : 0;
+		write_coverage_value(file, &viral_reads);
+
+		// only blocks which were allocated are written
+		uint32_t block_count = 0;
+		if (contig->second < blocks.size())
+			for (auto block = blocks[contig->second].begin(); block != blocks[contig->second].end(); ++block)
+				if (*block)
+					block_count++;
+		write_coverage_value(file, &block_count);
+		for (uint32_t block = 0; block_count > 0 && block < blocks[contig->second].size(); ++block) {
+			if (blocks[contig->second][block]) {
+				const block_t& this_block = *blocks[contig->second][block];
+				write_coverage_value(file, &block);
+				write_coverage_value(file, this_block.coverage, BLOCK_SIZE);
+				uint8_t bits[2 * BLOCK_SIZE / 8] = {};
+				for (unsigned int window = 0; window < BLOCK_SIZE; ++window) {
+					bits[window / 8] |= this_block.fragment_starts[window] << (window % 8);
+					bits[(BLOCK_SIZE + window) / 8] |= this_block.fragment_ends[window] << (window % 8);
+				}
+				write_coverage_value(file, bits, sizeof(bits));
+			}
+		}
+	}
+
+	crash(fclose(file) != 0, "failed to write coverage file");
+}
+
+void coverage_t::read_from_file(const string& input_file, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, const bool resolution_given, unsigned long int& mapped_reads, vector<unsigned long int>& mapped_viral_reads_by_contig) {
+
+	FILE* file = fopen(input_file.c_str(), "rb");
+	crash(file == NULL, "failed to open coverage file: " + input_file);
+
+	char signature[sizeof(COVERAGE_FILE_SIGNATURE)];
+	read_coverage_value(file, signature, sizeof(signature));
+	crash(memcmp(signature, COVERAGE_FILE_SIGNATURE, sizeof(signature)) != 0, "not a coverage file written by this version of Arriba: " + input_file);
+	int32_t resolution;
+	read_coverage_value(file, &resolution);
+	crash(resolution < 1, "invalid resolution in coverage file");
+	crash(resolution_given && resolution != this->resolution, "coverage file was computed at a resolution of " + to_string(static_cast<long long int>(resolution)) + " bp, which differs from the one given via -w");
+
+	// the counts in the coverage file include the reads of Chimeric.out.sam,
+	// so they replace the counts gathered so far rather than being added to them
+	uint64_t reads;
+	read_coverage_value(file, &reads);
+	mapped_reads = reads;
+	uint32_t contig_count;
+	read_coverage_value(file, &contig_count);
+
+	// the coverage file replaces all coverage gathered so far
+	this->resolution = resolution;
+	mapped_viral_reads_by_contig.assign(contigs.size(), 0);
+	windows.clear();
+	blocks.clear();
+	resize(contigs, assembly);
+
+	for (uint32_t i = 0; i < contig_count; ++i) {
+		string contig_name = read_coverage_string(file);
+		string original_contig_name = read_coverage_string(file);
+		uint32_t contig_windows;
+		read_coverage_value(file, &contig_windows);
+		uint64_t viral_reads;
+		read_coverage_value(file, &viral_reads);
+
+		// add contigs which are not yet listed in <contigs>, just like when reading a BAM header
+		contig_t contig = contigs.insert(pair<string,contig_t>(contig_name, contigs.size())).first->second;
+		crash(contigs.size() == USHRT_MAX - 1, "too many contigs");
+		if (contigs.size() > original_contig_names.size())
+			original_contig_names.resize(contigs.size());
+		original_contig_names[contig] = original_contig_name;
+		if (contigs.size() > mapped_viral_reads_by_contig.size())
+			mapped_viral_reads_by_contig.resize(contigs.size());
+		mapped_viral_reads_by_contig[contig] = viral_reads;
+
+		// make sure the coverage was computed with the same assembly
+		if (contig >= windows.size()) { // contigs which are not in the assembly have no windows
+			windows.resize(contigs.size());
+			blocks.resize(contigs.size());
+		}
+		crash(windows[contig] != contig_windows, "coverage file does not match assembly: contig '" + original_contig_name + "' has a different length");
+
+		uint32_t block_count;
+		read_coverage_value(file, &block_count);
+		for (uint32_t j = 0; j < block_count; ++j) {
+			uint32_t block;
+			read_coverage_value(file, &block);
+			crash(block >= blocks[contig].size(), "invalid block in coverage file");
+			block_t& this_block = get_block(contig, block * BLOCK_SIZE);
+			read_coverage_value(file, this_block.coverage, BLOCK_SIZE);
+			uint8_t bits[2 * BLOCK_SIZE / 8];
+			read_coverage_value(file, bits, sizeof(bits));
+			for (unsigned int window = 0; window < BLOCK_SIZE; ++window) {
+				this_block.fragment_starts[window] = (bits[window / 8] >> (window % 8)) & 1;
+				this_block.fragment_ends[window] = (bits[(BLOCK_SIZE + window) / 8] >> (window % 8)) & 1;
+			}
+		}
+	}
+
+	fclose(file);
+}
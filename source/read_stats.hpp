@@ -1,6 +1,9 @@
 #ifndef _READ_STATS_H
 #define _READ_STATS_H 1
 
+#include <bitset>
+#include <memory>
+#include <string>
 #include <vector>
 #include "common.hpp"
 #include "annotation.hpp"
@@ -11,19 +14,57 @@ bool estimate_fragment_length(const chimeric_alignments_t& chimeric_alignments,
 
 strandedness_t detect_strandedness(const chimeric_alignments_t& chimeric_alignments, const gene_annotation_index_t& gene_annotation_index, const exon_annotation_index_t& exon_annotation_index);
 
-const int COVERAGE_RESOLUTION = 20; // at what resolution in bp to calculate the coverage
-// for each contig store for every window of <COVERAGE_RESOLUTION> bp whether a read starts/ends here
+const int COVERAGE_RESOLUTION = 20; // default resolution in bp at which to calculate the coverage
+// for each contig store for every window of <resolution> bp whether a read starts/ends here
 // this information is needed by the 'no_coverage' filter
+// the windows are grouped in blocks, which are only allocated once a read overlaps them,
+// such that memory consumption scales with the size of the transcriptome rather than the genome
 class coverage_t {
+	private:
+		static const unsigned int BLOCK_SIZE = 256; // windows per block
+		struct block_t {
+			unsigned short int coverage[BLOCK_SIZE]; // for each window, store the coverage
+			bitset<BLOCK_SIZE> fragment_starts; // for each window, store if a fragment starts here
+			bitset<BLOCK_SIZE> fragment_ends; // for each window, store if a fragment ends here
+			block_t(): coverage() {};
+		};
+		int resolution;
+		vector<unsigned int> windows; // number of windows of each contig, 0 if the contig is ignored
+		vector< vector< unique_ptr<block_t> > > blocks;
+		block_t& get_block(const contig_t contig, const unsigned int window) {
+			unique_ptr<block_t>& block = blocks[contig][window / BLOCK_SIZE];
+			if (!block)
+				block.reset(new block_t());
+			return *block;
+		};
+		const block_t* find_block(const contig_t contig, const unsigned int window) const {
+			if (contig >= blocks.size() || window >= windows[contig])
+				return NULL;
+			return blocks[contig][window / BLOCK_SIZE].get();
+		};
 	public:
-		vector< vector<bool> > fragment_starts; // for each window, store if a fragment starts here
-		vector< vector<bool> > fragment_ends; // for each window, store if a fragment ends here
-		vector< vector<unsigned short int> > coverage; // for each window, store the coverage
+		coverage_t(): resolution(COVERAGE_RESOLUTION) {};
+		void set_resolution(const int resolution) { this->resolution = resolution; }; // must be called before resize()
+		int get_resolution() const { return resolution; };
 		void resize(const contigs_t& contigs, const assembly_t& assembly);
+		void resize(const coverage_t& other); // make the same windows as <other>, but without coverage
+		void merge(const coverage_t& other); // add the coverage of <other>, which must have the same windows
+		void swap(coverage_t& other) {
+			std::swap(resolution, other.resolution);
+			windows.swap(other.windows);
+			blocks.swap(other.blocks);
+		};
 		void add_fragment(bam1_t* mate1, bam1_t* mate2, bool is_chimeric);
 		bool fragment_starts_here(const contig_t contig, const position_t start, const position_t end) const;
 		bool fragment_ends_here(const contig_t contig, const position_t start, const position_t end) const;
 		int get_coverage(const contig_t contig, const position_t position, const direction_t direction) const;
+		unsigned int get_windows(const contig_t contig) const { return (contig < windows.size()) ? windows[contig] : 0; };
+		void write_to_file(const string& output_file, const contigs_t& contigs, const vector<string>& original_contig_names, const unsigned long int mapped_reads, const vector<unsigned long int>& mapped_viral_reads_by_contig) const;
+		void read_from_file(const string& input_file, contigs_t& contigs, vector<string>& original_contig_names, const assembly_t& assembly, const bool resolution_given, unsigned long int& mapped_reads, vector<unsigned long int>& mapped_viral_reads_by_contig);
+		unsigned short int get_window_coverage(const contig_t contig, const unsigned int window) const {
+			const block_t* block = find_block(contig, window);
+			return (block == NULL) ? 0 : block->coverage[window % BLOCK_SIZE];
+		};
 };
 
 #endif /* _READ_STATS_H */
@@ -1,4 +1,5 @@
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -25,6 +26,10 @@ unsigned int recover_known_fusions(fusions_t& fusions, const string& known_fusio
 			tsv_stream_t tsv(line);
 			string range1, range2;
 			tsv >> range1 >> range2;
+			if (tsv.fail()) {
+				cerr << "WARNING: failed to parse line in known fusions file: " << line << endl;
+				continue;
+			}
 			blacklist_item_t item1, item2;
 			if (!parse_blacklist_item(range1, item1, contigs, genes, false) ||
 			    !parse_blacklist_item(range2, item2, contigs, genes, false))